@@ -1,5 +1,10 @@
 #include "minicsv.h"
 #include <iostream>
+#if __cplusplus > 201703L && defined(__has_include)
+#	if __has_include(<ranges>)
+#		include <ranges>
+#	endif
+#endif
 
 using namespace mini;
 
@@ -17,6 +22,31 @@ bool test_file_write_double_quotes(const std::string& name, int qty, bool enable
 
 bool test_file_precision(const std::string & file, const std::string & name, bool enable_quote, char delimiter, const std::string & escape);
 bool test_precision(const std::string & name, bool enable_quote, char delimiter, const std::string & escape);
+bool test_input_buffer();
+bool test_output_buffer();
+bool test_write_row();
+bool test_field_offsets();
+bool test_sniff();
+bool test_fixed_dialect();
+bool test_parallel_writer();
+bool test_columnar_cache();
+bool test_external_sort();
+bool test_group_aggregator();
+bool test_hash_join();
+bool test_dedup();
+bool test_row_generator();
+bool test_row_iterator();
+bool test_follow();
+bool test_split_ranges();
+bool test_error_collection();
+bool test_multi_char_delimiter();
+bool test_utf8_utf16();
+bool test_timestamp();
+bool test_decimal();
+bool test_checksum();
+bool test_field_sink();
+bool test_row_dispatcher();
+bool test_pipeline();
 
 int main()
 {
@@ -54,6 +84,32 @@ int main()
 	test_get_rest_of_line("Fruits");
 	test_file_get_rest_of_line("Fruits");
 
+	test_input_buffer();
+	test_output_buffer();
+	test_write_row();
+	test_field_offsets();
+	test_sniff();
+	test_fixed_dialect();
+	test_parallel_writer();
+	test_columnar_cache();
+	test_external_sort();
+	test_group_aggregator();
+	test_hash_join();
+	test_dedup();
+	test_row_generator();
+	test_row_iterator();
+	test_follow();
+	test_split_ranges();
+	test_error_collection();
+	test_multi_char_delimiter();
+	test_utf8_utf16();
+	test_timestamp();
+	test_decimal();
+	test_checksum();
+	test_field_sink();
+	test_row_dispatcher();
+	test_pipeline();
+
 	//test_file_precision("test_file_precision.txt", "Fruits World", true, ',', "$$");
 	//test_precision("Fruits World", false, ',', "");
 
@@ -498,3 +554,1518 @@ bool test_file_write_double_quotes(const std::string& name, int qty, bool enable
 	return true;
 }
 
+
+bool test_input_buffer()
+{
+	const char buf1[] = "Apple;10\n\"Pear;Plum\";20\n";
+	const char buf2[] = "Grape;30";
+
+	csv::istringstream is(buf1, sizeof(buf1) - 1);
+	is.set_delimiter(';', "$$");
+	is.enable_trim_quote_on_str(true, '\"');
+
+	std::string dest_name = "";
+	int dest_qty = 0;
+
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	MYASSERT(__FUNCTION__, is.get_line(), "Apple;10");
+	is >> dest_name >> dest_qty;
+	MYASSERT(__FUNCTION__, dest_name, "Apple");
+	MYASSERT(__FUNCTION__, dest_qty, 10);
+
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	is >> dest_name >> dest_qty;
+	MYASSERT(__FUNCTION__, dest_name, "Pear;Plum");
+	MYASSERT(__FUNCTION__, dest_qty, 20);
+	MYASSERT(__FUNCTION__, is.read_line(), false);
+
+	// delimiter and quote settings are kept for the next buffer
+	is.set_new_input_buffer(buf2, sizeof(buf2) - 1);
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	is >> dest_name >> dest_qty;
+	MYASSERT(__FUNCTION__, dest_name, "Grape");
+	MYASSERT(__FUNCTION__, dest_qty, 30);
+	MYASSERT(__FUNCTION__, is.read_line(), false);
+
+	// a moved stream carries on where the other left off, with short owned text too
+	csv::istringstream owner(std::string("Fig;40;x\nKiwi;50;y"));
+	owner.set_delimiter(';', "$$");
+	MYASSERT(__FUNCTION__, owner.read_line(), true);
+	owner >> dest_name;
+	csv::istringstream moved(std::move(owner));
+	moved >> dest_qty;
+	MYASSERT(__FUNCTION__, dest_name, "Fig");
+	MYASSERT(__FUNCTION__, dest_qty, 40);
+	MYASSERT(__FUNCTION__, owner.read_line(), false);
+	csv::istringstream assigned;
+	assigned = std::move(moved);
+	MYASSERT(__FUNCTION__, assigned.read_line(), true);
+	assigned >> dest_name >> dest_qty;
+	MYASSERT(__FUNCTION__, dest_name, "Kiwi");
+	MYASSERT(__FUNCTION__, dest_qty, 50);
+	MYASSERT(__FUNCTION__, moved.read_line(), false);
+
+	std::vector<csv::istringstream> streams;
+	streams.push_back(csv::istringstream(buf2, sizeof(buf2) - 1));
+	streams.push_back(csv::istringstream(std::string("Lime,60")));
+	MYASSERT(__FUNCTION__, streams[1].read_line(), true);
+	streams[1] >> dest_name >> dest_qty;
+	MYASSERT(__FUNCTION__, dest_name, "Lime");
+	MYASSERT(__FUNCTION__, dest_qty, 60);
+	return true;
+}
+
+bool test_output_buffer()
+{
+	csv::ostringstream os;
+	os.set_delimiter(',', "$$");
+	os.reserve(64);
+
+	os << "Apple" << 10 << NEWLINE;
+	std::string text = os.take_text();
+	MYASSERT(__FUNCTION__, text, "Apple,10\n");
+	MYASSERT(__FUNCTION__, os.get_text(), "");
+
+	os << "Pear" << 20 << NEWLINE;
+	os.clear();
+	os << "Plum" << 30 << NEWLINE;
+	MYASSERT(__FUNCTION__, os.get_text(), "Plum,30\n");
+
+	std::string response = "HEADER\n";
+	os.set_output_string(response);
+	os << "Grape" << 40 << NEWLINE;
+	MYASSERT(__FUNCTION__, response, "HEADER\nGrape,40\n");
+
+	// the stream accessor writes into the same text, and its str() reads and replaces it
+	csv::ostringstream legacy;
+	csv::text_ostream& raw = legacy.get_ostringstream();
+	legacy << "Gone" << NEWLINE;
+	MYASSERT(__FUNCTION__, raw.str(), "Gone\n");
+	raw.str("");
+	legacy << "Fig" << 50;
+	raw << ",x";
+	legacy << NEWLINE;
+	MYASSERT(__FUNCTION__, legacy.get_text(), "Fig,50,x\n");
+	MYASSERT(__FUNCTION__, raw.str(), "Fig,50,x\n");
+
+	// a moved stream keeps the text and the settings
+	legacy.set_delimiter(';', "$$");
+	csv::ostringstream moved(std::move(legacy));
+	moved << "Kiwi" << 60 << NEWLINE;
+	MYASSERT(__FUNCTION__, moved.get_text(), "Fig,50,x\nKiwi;60\n");
+	MYASSERT(__FUNCTION__, legacy.get_text(), "");
+	std::vector<csv::ostringstream> outputs;
+	outputs.push_back(std::move(moved));
+	outputs.push_back(csv::ostringstream(response));
+	outputs[1] << "Lime" << 70 << NEWLINE;
+	MYASSERT(__FUNCTION__, response, "HEADER\nGrape,40\nLime,70\n");
+	outputs[0].get_ostringstream() << "end";
+	outputs[0] << NEWLINE;
+	MYASSERT(__FUNCTION__, outputs[0].take_text(), "Fig,50,x\nKiwi;60\nend\n");
+	return true;
+}
+
+bool test_write_row()
+{
+	char ch = 'A';
+	csv::ostringstream expected;
+	expected.set_delimiter(',', "");
+	expected.enable_surround_quote_on_str(true, '\"', "\"\"");
+	expected << std::string("Towel, Soap") << 300 << 6.5 << 'X' << -7L << NEWLINE;
+	expected.set_precision(2);
+	expected << "Shampoo" << 200u << 15.0f << csv::NChar(ch) << NEWLINE;
+
+	csv::ostringstream os;
+	os.set_delimiter(',', "");
+	os.enable_surround_quote_on_str(true, '\"', "\"\"");
+	os.write_row(std::string("Towel, Soap"), 300, 6.5, 'X', -7L);
+	os.set_precision(2);
+	os.write_row(std::make_tuple("Shampoo", 200u, 15.0f, csv::NChar(ch)));
+	MYASSERT(__FUNCTION__, os.get_text(), expected.get_text());
+
+	csv::ofstream ofs("test_file_write_row.txt");
+	ofs.set_delimiter(',', "");
+	ofs.enable_surround_quote_on_str(true, '\"', "\"\"");
+	ofs.write_row(std::string("Towel, Soap"), 300, 6.5, 'X', -7L);
+	ofs.set_precision(2);
+	ofs.write_row("Shampoo", 200u, 15.0f, csv::NChar(ch));
+	ofs.flush();
+	ofs.close();
+
+	std::ifstream ifs("test_file_write_row.txt");
+	std::string file_text((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+	MYASSERT(__FUNCTION__, file_text, expected.get_text());
+	return true;
+}
+
+bool test_field_offsets()
+{
+	csv::istringstream is("Apple,\"Pear, Plum\",10,\"say \"\"hi\"\"\"\nGrape,,20,\r\n");
+	is.set_delimiter(',', "$$");
+	is.enable_trim_quote_on_str(true, '\"');
+	is.enable_field_offsets(true);
+
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	MYASSERT(__FUNCTION__, is.field_count(), 4);
+	MYASSERT(__FUNCTION__, is.num_of_delimiter(), 3);
+	MYASSERT(__FUNCTION__, is.field(3), "say \"hi\"");
+	MYASSERT(__FUNCTION__, is.field(1), "Pear, Plum");
+	MYASSERT(__FUNCTION__, is.raw_field(1).to_string(), "\"Pear, Plum\"");
+
+	std::string name, fruits, quote;
+	int qty = 0;
+	is >> name >> fruits >> qty >> quote;
+	MYASSERT(__FUNCTION__, fruits, is.field(1));
+	MYASSERT(__FUNCTION__, quote, is.field(3));
+	MYASSERT(__FUNCTION__, is.field(0), "Apple");
+
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	MYASSERT(__FUNCTION__, is.field_count(), 4);
+	MYASSERT(__FUNCTION__, is.field(1), "");
+	MYASSERT(__FUNCTION__, is.field(2), "20");
+	MYASSERT(__FUNCTION__, is.field(3), "");
+	return true;
+}
+
+bool test_sniff()
+{
+	const std::string text = "Name;Qty;Price\nApple;10;1.5\nPear;20;2\n\"Plum;Fig\";30;3.25\n";
+	csv::istringstream is(text);
+
+	csv::dialect_info info = is.sniff(32); // the sample stops before the quoted line
+	MYASSERT(__FUNCTION__, info.delimiter, ';');
+	MYASSERT(__FUNCTION__, info.column_count, 3);
+	MYASSERT(__FUNCTION__, info.has_quotes, false);
+	MYASSERT(__FUNCTION__, info.has_escapes, false);
+	MYASSERT(__FUNCTION__, info.has_header, true);
+	MYASSERT(__FUNCTION__, info.column_types[0], csv::dialect_info::text_column);
+	MYASSERT(__FUNCTION__, info.column_types[1], csv::dialect_info::integer_column);
+	MYASSERT(__FUNCTION__, info.column_types[2], csv::dialect_info::float_column);
+
+	is.set_dialect(info);
+	is.read_line(); // header
+
+	std::string name;
+	int qty = 0;
+	double price = 0.0;
+	int cnt = 0;
+	while (is.read_line())
+	{
+		is >> name >> qty >> price;
+		++cnt;
+	}
+	// quotes after the sample are still handled
+	MYASSERT(__FUNCTION__, name, "Plum;Fig");
+	MYASSERT(__FUNCTION__, qty, 30);
+	MYASSERT(__FUNCTION__, price, 3.25);
+	MYASSERT(__FUNCTION__, cnt, 3);
+	return true;
+}
+
+bool test_fixed_dialect()
+{
+	typedef csv::dialect<'|', '\"', csv::escape::none> pipe_dialect;
+
+	csv::fixed_ostringstream<pipe_dialect> os;
+	os << "Pear|Plum" << "say \"hi\"" << 10 << NEWLINE;
+	os.write_row("Apple", "a&quot;b", 20);
+	MYASSERT(__FUNCTION__, os.get_text(), "\"Pear|Plum\"|\"say \"\"hi\"\"\"|10\nApple|a&quot;b|20\n");
+
+	csv::fixed_istringstream<pipe_dialect> is(os.get_text());
+	std::string name, quote;
+	int qty = 0;
+
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	is >> name >> quote >> qty;
+	MYASSERT(__FUNCTION__, name, "Pear|Plum");
+	MYASSERT(__FUNCTION__, quote, "say \"hi\"");
+	MYASSERT(__FUNCTION__, qty, 10);
+
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	is >> name >> quote >> qty;
+	MYASSERT(__FUNCTION__, name, "Apple");
+	MYASSERT(__FUNCTION__, quote, "a&quot;b");
+	MYASSERT(__FUNCTION__, qty, 20);
+
+	csv::fixed_istringstream< csv::dialect<'\t', '\0', csv::escape::none> > tsv("\"a\"\tb##\t3");
+	MYASSERT(__FUNCTION__, tsv.read_line(), true);
+	tsv >> name >> quote >> qty;
+	MYASSERT(__FUNCTION__, name, "\"a\"");
+	MYASSERT(__FUNCTION__, quote, "b##");
+	MYASSERT(__FUNCTION__, qty, 3);
+
+	{
+		std::ofstream out("test_file_fixed.txt", std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+		out << "a|1\nb|2\nc|3\n";
+	}
+	// a split keeps the dialect
+	csv::fixed_ifstream<pipe_dialect> fs;
+	fs.open("test_file_fixed.txt", 4, 100);
+	MYASSERT(__FUNCTION__, fs.read_line(), true);
+	fs >> name >> qty;
+	MYASSERT(__FUNCTION__, name, "b");
+	MYASSERT(__FUNCTION__, qty, 2);
+	// the base open goes back to the runtime dialect, comma separated
+	fs.close();
+	fs.ifstream::open("test_file_fixed.txt");
+	MYASSERT(__FUNCTION__, fs.read_line(), true);
+	fs >> name;
+	MYASSERT(__FUNCTION__, name, "a|1");
+	return true;
+}
+
+bool test_parallel_writer()
+{
+	std::vector<std::tuple<int, std::string, double> > rows;
+	for (int i = 0; i < 10000; ++i)
+		rows.push_back(std::make_tuple(i, (i % 3 == 0) ? "Towel, Soap" : "Shampoo", i * 0.5));
+
+	csv::ostringstream expected;
+	expected.set_delimiter(',', "");
+	expected.enable_surround_quote_on_str(true, '\"', "\"\"");
+	for (size_t i = 0; i < rows.size(); ++i)
+		expected.write_row(rows[i]);
+
+	csv::ofstream os("test_file_parallel_writer.txt");
+	os.set_delimiter(',', "");
+	os.enable_surround_quote_on_str(true, '\"', "\"\"");
+	csv::parallel_writer writer(os, 4, 100);
+	writer.write(rows);
+	os.flush();
+	os.close();
+
+	std::ifstream ifs("test_file_parallel_writer.txt");
+	std::string file_text((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+	const bool same = (file_text == expected.get_text());
+	MYASSERT(__FUNCTION__, same, true);
+	return true;
+}
+
+void skip_header(csv::ifstream& is)
+{
+	is.set_delimiter(',', "");
+	is.enable_trim_quote_on_str(true, '\"');
+	is.skip_line();
+}
+
+bool test_columnar_cache()
+{
+	csv::ofstream os("test_file_columnar.txt");
+	os.set_delimiter(',', "");
+	os.write_row("Name", "Qty", "Price");
+	for (int i = 0; i < 1000; ++i)
+		os.write_row((i % 2) ? "Towel, Soap" : "Shampoo", i, i * 0.25);
+	os.flush();
+	os.close();
+	std::remove("test_file_columnar.txt.mcc");
+
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		csv::columnar_table<std::string, int, double> table;
+		MYASSERT(__FUNCTION__, table.load("test_file_columnar.txt", skip_header), true);
+		const bool expected_from_cache = (pass == 1);
+		MYASSERT(__FUNCTION__, table.loaded_from_cache(), expected_from_cache);
+		MYASSERT(__FUNCTION__, table.rows(), 1000);
+		MYASSERT(__FUNCTION__, table.get<0>(0).to_string(), "Shampoo");
+		MYASSERT(__FUNCTION__, table.get<0>(999).to_string(), "Towel, Soap");
+		MYASSERT(__FUNCTION__, table.get<1>(999), 999);
+		MYASSERT(__FUNCTION__, table.column<2>()[4], 1.0);
+	}
+
+	// a cache made with another configuration is parsed again
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		csv::columnar_table<std::string, int, double> table;
+		MYASSERT(__FUNCTION__, table.load("test_file_columnar.txt", [](csv::ifstream& is) { skip_header(is); is.skip_line(); }), true);
+		const bool expected_from_cache = (pass == 1);
+		MYASSERT(__FUNCTION__, table.loaded_from_cache(), expected_from_cache);
+		MYASSERT(__FUNCTION__, table.rows(), 999);
+		MYASSERT(__FUNCTION__, table.get<0>(0).to_string(), "Towel, Soap");
+		MYASSERT(__FUNCTION__, table.get<1>(0), 1);
+	}
+
+	// an edit in the middle of the file which keeps its size is not missed
+	{
+		csv::columnar_table<std::string, int, double> table;
+		MYASSERT(__FUNCTION__, table.load("test_file_columnar.txt", skip_header), true);
+	}
+	{
+		std::fstream edit("test_file_columnar.txt", std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+		std::string text((std::istreambuf_iterator<char>(edit)), std::istreambuf_iterator<char>());
+		edit.clear();
+		edit.seekp(static_cast<std::streamoff>(text.find("Shampoo,500,") + 8));
+		edit.write("6", 1);
+	}
+	csv::columnar_table<std::string, int, double> edited;
+	MYASSERT(__FUNCTION__, edited.load("test_file_columnar.txt", skip_header), true);
+	MYASSERT(__FUNCTION__, edited.loaded_from_cache(), false);
+	MYASSERT(__FUNCTION__, edited.get<1>(500), 600);
+
+	// loads racing on a missing cache each write their own temporary file
+	std::remove("test_file_columnar.txt.mcc");
+	std::atomic<int> loaded(0);
+	std::vector<std::thread> loaders;
+	for (int t = 0; t < 4; ++t)
+	{
+		loaders.push_back(std::thread([&loaded]()
+		{
+			csv::columnar_table<std::string, int, double> table;
+			if (table.load("test_file_columnar.txt", skip_header) && table.rows() == 1000)
+				++loaded;
+		}));
+	}
+	for (size_t t = 0; t < loaders.size(); ++t)
+		loaders[t].join();
+	MYASSERT(__FUNCTION__, loaded.load(), 4);
+	csv::columnar_table<std::string, int, double> cached;
+	MYASSERT(__FUNCTION__, cached.load("test_file_columnar.txt", skip_header), true);
+	MYASSERT(__FUNCTION__, cached.loaded_from_cache(), true);
+	MYASSERT(__FUNCTION__, cached.get<1>(500), 600);
+	return true;
+}
+
+int count_sorted_rows(const char* file)
+{
+	csv::ifstream is(file);
+	is.enable_terminate_on_blank_line(false);
+	int rows = 0;
+	if (is.read_line() && is.get_line() == "Name,Qty")
+	{
+		while (is.read_line())
+			++rows;
+	}
+	return rows;
+}
+
+bool test_external_sort()
+{
+	csv::ofstream os("test_file_sort.txt");
+	os.set_delimiter(',', "##");
+	os.write_row("Name", "Qty");
+	for (int i = 0; i < 3000; ++i)
+		os.write_row((i % 3) ? ((i % 3 == 1) ? "Towel, Soap" : "Apple") : "Shampoo", (i * 7919) % 3000);
+	os.flush();
+	os.close();
+
+	// a tiny budget forces many runs and an intermediate merge pass
+	csv::external_sorter sorter(1024, 4);
+	sorter.set_header(true);
+	sorter.add_key(0);
+	sorter.add_key(1, true, true);
+	MYASSERT(__FUNCTION__, sorter.sort("test_file_sort.txt", "test_file_sorted.txt", [](csv::istream_base& is) { is.set_delimiter(',', "##"); }), true);
+
+	csv::ifstream is("test_file_sorted.txt");
+	is.set_delimiter(',', "##");
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	MYASSERT(__FUNCTION__, is.get_line(), "Name,Qty");
+	std::string prev_name;
+	int prev_qty = 0;
+	int rows = 0;
+	bool ordered = true;
+	while (is.read_line())
+	{
+		std::string name;
+		int qty = 0;
+		is >> name >> qty;
+		if (rows > 0 && (name < prev_name || (name == prev_name && qty > prev_qty)))
+			ordered = false;
+		prev_name = name;
+		prev_qty = qty;
+		++rows;
+	}
+	is.close();
+	MYASSERT(__FUNCTION__, rows, 3000);
+	MYASSERT(__FUNCTION__, ordered, true);
+	MYASSERT(__FUNCTION__, prev_name, "Towel, Soap");
+
+	// an interior blank line must not cut the sort short, with or without keys
+	{
+		std::ofstream ofs("test_file_sort.txt");
+		ofs << "Name,Qty\n";
+		for (int i = 0; i < 200; ++i)
+			ofs << ((i == 100) ? "\n" : "") << "Item" << (i % 7) << ',' << i << '\n';
+	}
+	csv::external_sorter blank_sorter(512, 4);
+	blank_sorter.set_header(true);
+	blank_sorter.add_key(0);
+	MYASSERT(__FUNCTION__, blank_sorter.sort("test_file_sort.txt", "test_file_sorted.txt"), true);
+	MYASSERT(__FUNCTION__, count_sorted_rows("test_file_sorted.txt"), 200);
+
+	csv::external_sorter keyless_sorter(512, 4);
+	keyless_sorter.set_header(true);
+	MYASSERT(__FUNCTION__, keyless_sorter.sort("test_file_sort.txt", "test_file_sorted.txt"), true);
+	MYASSERT(__FUNCTION__, count_sorted_rows("test_file_sorted.txt"), 200);
+	return true;
+}
+
+bool test_group_aggregator()
+{
+	csv::ofstream os("test_file_group.txt");
+	os.set_delimiter(',', "##");
+	os.write_row("Name", "Qty", "Price");
+	for (int i = 0; i < 3000; ++i)
+		os.write_row((i % 2) ? "Towel, Soap" : "Shampoo", i % 10, 0.5);
+	os.flush();
+	os.close();
+
+	// small blocks so that every thread gets some of the file
+	csv::group_aggregator agg(4, 256);
+	agg.set_header(true);
+	agg.group_by(0);
+	agg.add(csv::group_aggregator::count);
+	agg.add(csv::group_aggregator::sum, 2);
+	agg.add(csv::group_aggregator::max, 1);
+	agg.add(csv::group_aggregator::mean, 1);
+	MYASSERT(__FUNCTION__, agg.run("test_file_group.txt", [](csv::istream_base& is) { is.set_delimiter(',', "##"); }), true);
+
+	const std::vector<csv::group_aggregator::group>& groups = agg.results();
+	MYASSERT(__FUNCTION__, groups.size(), 2);
+	MYASSERT(__FUNCTION__, groups[0].keys[0], "Shampoo");
+	MYASSERT(__FUNCTION__, groups[1].keys[0], "Towel, Soap");
+	MYASSERT(__FUNCTION__, groups[0].values[0], 1500.0);
+	MYASSERT(__FUNCTION__, groups[1].values[1], 750.0);
+	MYASSERT(__FUNCTION__, groups[0].values[2], 8.0);
+	MYASSERT(__FUNCTION__, groups[1].values[3], 5.0);
+
+	// sums and means are written without losing digits
+	csv::ofstream big("test_file_group.txt");
+	big.set_delimiter(',', "##");
+	big.write_row("Name", "Price");
+	big.write_row("Towel", "1234567.125");
+	big.write_row("Towel", "1234567.125");
+	big.write_row("Soap", "0.1");
+	big.write_row("Soap", "0.2");
+	big.flush();
+	big.close();
+	csv::group_aggregator totals(2, 256);
+	totals.set_header(true);
+	totals.group_by(0);
+	totals.add(csv::group_aggregator::sum, 1);
+	totals.add(csv::group_aggregator::mean, 1);
+	MYASSERT(__FUNCTION__, totals.run("test_file_group.txt", [](csv::istream_base& is) { is.set_delimiter(',', "##"); }), true);
+	csv::ofstream out("test_file_group_totals.txt");
+	out.set_delimiter(',', "##");
+	totals.write(out);
+	out.flush();
+	out.close();
+	csv::ifstream is("test_file_group_totals.txt");
+	is.set_delimiter(',', "##");
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	MYASSERT(__FUNCTION__, is.get_line(), "Soap,0.30000000000000004,0.15000000000000002");
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	MYASSERT(__FUNCTION__, is.get_line(), "Towel,2469134.25,1234567.125");
+	is.close();
+
+	// a group without any number has no min, max or mean
+	csv::ofstream none("test_file_group.txt");
+	none.set_delimiter(',', "##");
+	none.write_row("Name", "Price");
+	none.write_row("Mop", "n/a");
+	none.write_row("Mop", "");
+	none.flush();
+	none.close();
+	csv::group_aggregator empty(1, 256);
+	empty.set_header(true);
+	empty.group_by(0);
+	empty.add(csv::group_aggregator::sum, 1);
+	empty.add(csv::group_aggregator::min, 1);
+	empty.add(csv::group_aggregator::max, 1);
+	empty.add(csv::group_aggregator::mean, 1);
+	MYASSERT(__FUNCTION__, empty.run("test_file_group.txt", [](csv::istream_base& is) { is.set_delimiter(',', "##"); }), true);
+	const bool no_min = std::isnan(empty.results()[0].values[1]);
+	const bool no_mean = std::isnan(empty.results()[0].values[3]);
+	MYASSERT(__FUNCTION__, no_min, true);
+	MYASSERT(__FUNCTION__, no_mean, true);
+	csv::ofstream out_none("test_file_group_totals.txt");
+	out_none.set_delimiter(',', "##");
+	empty.write(out_none);
+	out_none.flush();
+	out_none.close();
+	is.open("test_file_group_totals.txt");
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	MYASSERT(__FUNCTION__, is.get_line(), "Mop,0,,,");
+	return true;
+}
+
+bool test_hash_join()
+{
+	csv::ofstream dim("test_file_dim.txt");
+	dim.set_delimiter(',', "##");
+	dim.write_row("Id", "Name");
+	dim.write_row(1, "Towel, Soap");
+	dim.write_row(2, "Shampoo");
+	dim.write_row(2, "Conditioner");
+	dim.flush();
+	dim.close();
+
+	csv::ofstream fact("test_file_fact.txt");
+	fact.set_delimiter(',', "##");
+	fact.write_row("Id", "Qty");
+	for (int i = 0; i < 1000; ++i)
+		fact.write_row(i % 4, i);
+	fact.flush();
+	fact.close();
+
+	auto configure = [](csv::istream_base& is) { is.set_delimiter(',', "##"); };
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		csv::hash_joiner join(4, 64);
+		join.set_header(true);
+		join.on(0, 0);
+		join.set_type(pass == 0 ? csv::hash_joiner::inner : csv::hash_joiner::left);
+		csv::ofstream os("test_file_joined.txt");
+		os.set_delimiter(',', "##");
+		MYASSERT(__FUNCTION__, join.run("test_file_dim.txt", "test_file_fact.txt", os, configure), true);
+		os.flush();
+		os.close();
+
+		csv::ifstream is("test_file_joined.txt");
+		is.set_delimiter(',', "##");
+		MYASSERT(__FUNCTION__, is.read_line(), true);
+		MYASSERT(__FUNCTION__, is.get_line(), "Id,Qty,Id,Name");
+		int rows = 0;
+		bool ordered = true;
+		int prev_qty = -1;
+		std::string name;
+		while (is.read_line())
+		{
+			int id = 0, qty = 0;
+			std::string build_id;
+			is >> id >> qty >> build_id >> name;
+			if (qty < prev_qty)
+				ordered = false;
+			prev_qty = qty;
+			if (rows == 0)
+			{
+				const std::string expected_name = (pass == 0) ? "Towel, Soap" : "";
+				MYASSERT(__FUNCTION__, name, expected_name);
+			}
+			++rows;
+		}
+		is.close();
+		const int expected_rows = (pass == 0) ? 750 : 1250;
+		MYASSERT(__FUNCTION__, rows, expected_rows);
+		MYASSERT(__FUNCTION__, ordered, true);
+	}
+	return true;
+}
+
+bool test_dedup()
+{
+	csv::ofstream os("test_file_dup.txt");
+	os.set_delimiter(',', "##");
+	os.write_row("Name", "Qty");
+	for (int i = 0; i < 2000; ++i)
+		os.write_row((i % 2) ? "Towel, Soap" : "Shampoo", i % 500);
+	os.flush();
+	os.close();
+
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		// the second pass spills to partition files past a tiny budget
+		csv::deduplicator dedup(pass == 0 ? 1024 * 1024 : 4096);
+		dedup.set_header(true);
+		MYASSERT(__FUNCTION__, dedup.run("test_file_dup.txt", "test_file_dedup.txt"), true);
+		MYASSERT(__FUNCTION__, dedup.row_count(), 2000);
+		MYASSERT(__FUNCTION__, dedup.duplicates(), 1500);
+
+		csv::ifstream is("test_file_dedup.txt");
+		is.set_delimiter(',', "##");
+		MYASSERT(__FUNCTION__, is.read_line(), true);
+		MYASSERT(__FUNCTION__, is.get_line(), "Name,Qty");
+		MYASSERT(__FUNCTION__, is.read_line(), true);
+		MYASSERT(__FUNCTION__, is.get_line(), "Shampoo,0");
+		int rows = 1;
+		while (is.read_line())
+			++rows;
+		MYASSERT(__FUNCTION__, rows, 500);
+	}
+
+	// on the name column only
+	csv::deduplicator by_name;
+	by_name.set_header(true);
+	by_name.add_key(0);
+	MYASSERT(__FUNCTION__, by_name.run("test_file_dup.txt", "test_file_dedup.txt", [](csv::istream_base& is) { is.set_delimiter(',', "##"); }), true);
+	MYASSERT(__FUNCTION__, by_name.duplicates(), 1998);
+
+	// partitions still over the budget are partitioned again
+	csv::ofstream many("test_file_dup.txt");
+	many.set_delimiter(',', "##");
+	for (int i = 0; i < 40000; ++i)
+		many.write_row("Item", i % 20000);
+	many.flush();
+	many.close();
+	csv::deduplicator deep(2048);
+	MYASSERT(__FUNCTION__, deep.run("test_file_dup.txt", "test_file_dedup.txt"), true);
+	MYASSERT(__FUNCTION__, deep.duplicates(), 20000);
+	std::vector<bool> found(20000, false);
+	int unique_rows = 0;
+	csv::ifstream is("test_file_dedup.txt");
+	is.set_delimiter(',', "##");
+	while (is.read_line())
+	{
+		std::string name;
+		int id = 0;
+		is >> name >> id;
+		if (!found[id])
+			++unique_rows;
+		found[id] = true;
+	}
+	MYASSERT(__FUNCTION__, unique_rows, 20000);
+	std::ifstream leftover("test_file_dedup.txt.part0.0");
+	MYASSERT(__FUNCTION__, leftover.is_open(), false);
+	return true;
+}
+
+#ifdef MINICSV_HAS_COROUTINES
+csv::generator<csv::row_view> only_towels(csv::generator<csv::row_view> rows)
+{
+	for (const csv::row_view& row : rows)
+	{
+		if (row[0] == "Towel, Soap")
+			co_yield row;
+	}
+}
+#endif
+
+bool test_row_generator()
+{
+#ifdef MINICSV_HAS_COROUTINES
+	csv::istringstream is("Shampoo,1\nTowel## Soap,2\nTowel## Soap,3\nShampoo,4");
+	is.set_delimiter(',', "##");
+	int total = 0;
+	for (const csv::row_view& row : only_towels(is.rows()))
+		total += row.as<int>(1);
+	MYASSERT(__FUNCTION__, total, 5);
+
+#ifdef __cpp_lib_ranges
+	const std::string text = "Shampoo,1\nTowel## Soap,2\nShampoo,4";
+	is.set_new_input_buffer(text.data(), text.size());
+	int rows = 0;
+	for (const csv::row_view& row : is.rows() | std::views::filter([](const csv::row_view& r) { return r[0] == "Shampoo"; }))
+	{
+		MYASSERT(__FUNCTION__, row.size(), 2);
+		++rows;
+	}
+	MYASSERT(__FUNCTION__, rows, 2);
+#endif
+#endif
+	return true;
+}
+
+bool is_towel(const csv::row_view& row)
+{
+	return row[0] == "Towel, Soap";
+}
+
+bool test_row_iterator()
+{
+	const std::string text = "Shampoo,1\nTowel## Soap,2\nTowel## Soap,3\nShampoo,4";
+	csv::istringstream is(text.data(), text.size());
+	is.set_delimiter(',', "##");
+	csv::row_range<csv::istringstream> rows = csv::rows_of(is);
+	const long towels = std::count_if(rows.begin(), rows.end(), is_towel);
+	MYASSERT(__FUNCTION__, towels, 2);
+
+	is.set_new_input_buffer(text.data(), text.size());
+	int total = 0;
+	for (const csv::row_view& row : csv::rows_of(is))
+		total += row.as<int>(1);
+	MYASSERT(__FUNCTION__, total, 10);
+
+#ifdef __cpp_lib_ranges
+	is.set_new_input_buffer(text.data(), text.size());
+	total = 0;
+	for (const csv::row_view& row : csv::rows_of(is) | std::views::filter(is_towel))
+		total += row.as<int>(1);
+	MYASSERT(__FUNCTION__, total, 5);
+
+	is.set_new_input_buffer(text.data(), text.size());
+	const long shampoos = std::ranges::count_if(csv::rows_of(is), [](const csv::row_view& row) { return !is_towel(row); });
+	MYASSERT(__FUNCTION__, shampoos, 2);
+#endif
+	return true;
+}
+
+bool test_follow()
+{
+	{
+		std::ofstream out("test_file_follow.txt", std::ios_base::out | std::ios_base::trunc);
+		out << "Shampoo,1\nTowel## Soap,2\nShamp";
+	}
+	csv::ifstream is("test_file_follow.txt");
+	is.set_delimiter(',', "##");
+	is.enable_follow(true, 50);
+	std::string name;
+	int qty = 0;
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	is >> name >> qty;
+	MYASSERT(__FUNCTION__, name, "Towel, Soap");
+	// the partial last line is held back until its newline is written
+	MYASSERT(__FUNCTION__, is.read_line(), false);
+
+	{
+		std::ofstream out("test_file_follow.txt", std::ios_base::out | std::ios_base::app);
+		out << "oo,3\n";
+	}
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	is >> name >> qty;
+	MYASSERT(__FUNCTION__, name, "Shampoo");
+	MYASSERT(__FUNCTION__, qty, 3);
+	MYASSERT(__FUNCTION__, is.get_offset(), 35);
+	MYASSERT(__FUNCTION__, is.read_line(), false);
+
+	// truncated and rewritten: read again from the start
+	{
+		std::ofstream out("test_file_follow.txt", std::ios_base::out | std::ios_base::trunc);
+		out << "Towel## Soap,4\n";
+	}
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	is >> name >> qty;
+	MYASSERT(__FUNCTION__, qty, 4);
+	return true;
+}
+
+bool test_split_ranges()
+{
+	csv::ofstream os("test_file_split.txt");
+	os.set_delimiter(',', "##");
+	for (int i = 0; i < 1000; ++i)
+		os.write_row((i % 2) ? "Towel, Soap" : "Shampoo", i);
+	os.flush();
+	os.close();
+
+	uint64_t size = 0;
+	int64_t mtime = 0;
+	csv::file_stat("test_file_split.txt", size, mtime);
+
+	// the splits together hold every line exactly once
+	const uint64_t splits = 7;
+	int rows = 0;
+	long long total = 0;
+	for (uint64_t k = 0; k < splits; ++k)
+	{
+		csv::ifstream is;
+		is.open("test_file_split.txt", size * k / splits, size * (k + 1) / splits);
+		is.set_delimiter(',', "##");
+		while (is.read_line())
+		{
+			std::string name;
+			int qty = 0;
+			is >> name >> qty;
+			total += qty;
+			++rows;
+		}
+	}
+	MYASSERT(__FUNCTION__, rows, 1000);
+	MYASSERT(__FUNCTION__, total, 499500);
+
+	// checkpoint after 10 lines, then resume
+	uint64_t offset = 0;
+	size_t line_num = 0;
+	{
+		csv::ifstream is;
+		is.open("test_file_split.txt", 0, size);
+		for (int i = 0; i < 10; ++i)
+			is.read_line();
+		offset = is.get_offset();
+		line_num = is.get_line_num();
+	}
+	csv::ifstream is;
+	is.open("test_file_split.txt", offset, size);
+	is.set_delimiter(',', "##");
+	is.set_line_num(line_num);
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	std::string name;
+	int qty = 0;
+	is >> name >> qty;
+	MYASSERT(__FUNCTION__, qty, 10);
+	MYASSERT(__FUNCTION__, is.get_line_num(), 11);
+	is.close();
+
+	// a plain open counts the same bytes as a ranged one, carriage returns included
+	{
+		std::ofstream out("test_file_split.txt", std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+		out << "Shampoo,1\r\nSoap,2\r\nTowel,3\r\n";
+	}
+	csv::ifstream plain("test_file_split.txt");
+	MYASSERT(__FUNCTION__, plain.read_line(), true);
+	offset = plain.get_offset();
+	MYASSERT(__FUNCTION__, offset, 11);
+	is.open("test_file_split.txt", offset, 24);
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	is >> name >> qty;
+	MYASSERT(__FUNCTION__, name, "Soap");
+	MYASSERT(__FUNCTION__, qty, 2);
+	return true;
+}
+
+template<typename Stream>
+std::string read_quarantined(Stream& is)
+{
+	std::ostringstream quarantine;
+	is.enable_error_collection(true);
+	is.set_quarantine(&quarantine);
+	int a = 0, b = 0;
+	while (is.read_line())
+		is >> a >> b;
+	return quarantine.str();
+}
+
+bool test_error_collection()
+{
+	const std::string text = "Shampoo,1,0.5\nTowel## Soap,two,x\nSoap,3,1.5\nBrush,,2.5";
+	csv::istringstream is(text.data(), text.size());
+	is.set_delimiter(',', "##");
+	std::ostringstream quarantine;
+	is.enable_error_collection(true);
+	is.set_quarantine(&quarantine);
+	int total = 0;
+	int bad_rows = 0;
+	while (is.read_line())
+	{
+		std::string name;
+		int qty = 0;
+		double price = 0.0;
+		is >> name >> qty >> price;
+		if (is.line_has_error())
+			++bad_rows;
+		else
+			total += qty;
+	}
+	MYASSERT(__FUNCTION__, total, 4);
+	MYASSERT(__FUNCTION__, bad_rows, 2);
+	MYASSERT(__FUNCTION__, is.error_count(), 3);
+	MYASSERT(__FUNCTION__, is.bad_line_count(), 2);
+	MYASSERT(__FUNCTION__, is.get_errors()[0].line, 2);
+	MYASSERT(__FUNCTION__, is.get_errors()[0].token_pos, 2);
+	MYASSERT(__FUNCTION__, is.get_errors()[0].token, "two");
+	MYASSERT(__FUNCTION__, quarantine.str(), "Towel## Soap,two,x\nBrush,,2.5\n");
+
+	// the whole line is quarantined when the bad field is the last one
+	const std::string last = "1,2\nx,3\n4,y\n5,6\n";
+	{
+		std::ofstream out("test_file_quarantine.txt", std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+		out << last;
+	}
+	csv::istringstream ss(last);
+	MYASSERT(__FUNCTION__, read_quarantined(ss), "x,3\n4,y\n");
+	csv::ifstream fs("test_file_quarantine.txt");
+	MYASSERT(__FUNCTION__, read_quarantined(fs), "x,3\n4,y\n");
+	fs.close();
+
+	// get_line past the last field leaves the line to quarantine as it was read
+	fs.open("test_file_quarantine.txt");
+	std::ostringstream missing;
+	fs.enable_error_collection(true);
+	fs.set_quarantine(&missing);
+	int a = 0, b = 0, c = 0;
+	MYASSERT(__FUNCTION__, fs.read_line(), true);
+	fs >> a >> b;
+	MYASSERT(__FUNCTION__, fs.get_line(), "");
+	fs >> c;
+	MYASSERT(__FUNCTION__, missing.str(), "1,2\n");
+
+	// try_read does not throw outside of error collection mode either
+	csv::istringstream is2("Shampoo,abc");
+	MYASSERT(__FUNCTION__, is2.read_line(), true);
+	std::string name;
+	int qty = 0;
+	is2 >> name;
+	MYASSERT(__FUNCTION__, csv::try_read(is2, qty), false);
+	MYASSERT(__FUNCTION__, is2.is_collecting_errors(), false);
+	MYASSERT(__FUNCTION__, is2.error_count(), 1);
+	return true;
+}
+
+bool test_multi_char_delimiter()
+{
+	csv::ostringstream os;
+	os.set_delimiter("~|~", "##");
+	os << "Towel~|~Soap" << "Shampoo|Brush" << 3 << NEWLINE;
+	MYASSERT(__FUNCTION__, os.get_text(), "Towel##Soap~|~Shampoo|Brush~|~3\n");
+
+	csv::istringstream is(os.get_text());
+	is.set_delimiter("~|~", "##");
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	MYASSERT(__FUNCTION__, is.num_of_delimiter(), 2);
+	std::string towel, shampoo;
+	int qty = 0;
+	is >> towel >> shampoo >> qty;
+	MYASSERT(__FUNCTION__, towel, "Towel~|~Soap");
+	MYASSERT(__FUNCTION__, shampoo, "Shampoo|Brush");
+	MYASSERT(__FUNCTION__, qty, 3);
+
+	// quoted fields and the field offsets table
+	csv::istringstream quoted("\"a||b\"||c|d||");
+	quoted.set_delimiter("||", "");
+	quoted.enable_trim_quote_on_str(true, '\"');
+	quoted.enable_field_offsets(true);
+	MYASSERT(__FUNCTION__, quoted.read_line(), true);
+	MYASSERT(__FUNCTION__, quoted.field_count(), 3);
+	MYASSERT(__FUNCTION__, quoted.field(0), "a||b");
+	MYASSERT(__FUNCTION__, quoted.field(1), "c|d");
+	MYASSERT(__FUNCTION__, quoted.field(2), "");
+	return true;
+}
+
+bool test_utf8_utf16()
+{
+	// U+00DC, U+20AC and U+1F600 in UTF-16 with either byte order
+	const unsigned short units[] = { 0xFEFF, 0xDC, 'x', ',', '1', '\n', 0x20AC, 0xD83D, 0xDE00, ',', '2', '\n' };
+	for (int big_endian = 0; big_endian < 2; ++big_endian)
+	{
+		{
+			std::ofstream out("test_file_utf16.txt", std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+			for (size_t i = 0; i < sizeof(units) / sizeof(units[0]); ++i)
+			{
+				const char lo = static_cast<char>(units[i] & 0xFF);
+				const char hi = static_cast<char>(units[i] >> 8);
+				out.put(big_endian ? hi : lo);
+				out.put(big_endian ? lo : hi);
+			}
+		}
+		csv::ifstream is("test_file_utf16.txt");
+		MYASSERT(__FUNCTION__, is.is_transcoding(), true);
+		// the sample is taken from the transcoded text, and reading starts from the top
+		csv::dialect_info info = is.sniff();
+		MYASSERT(__FUNCTION__, info.column_count, 2);
+		const bool integer_column = (info.column_types.size() == 2 && info.column_types[1] == csv::dialect_info::integer_column);
+		MYASSERT(__FUNCTION__, integer_column, true);
+		std::string name;
+		int qty = 0;
+		MYASSERT(__FUNCTION__, is.read_line(), true);
+		is >> name >> qty;
+		MYASSERT(__FUNCTION__, name, "\xC3\x9Cx");
+		MYASSERT(__FUNCTION__, is.read_line(), true);
+		is >> name >> qty;
+		MYASSERT(__FUNCTION__, name, "\xE2\x82\xAC\xF0\x9F\x98\x80");
+		MYASSERT(__FUNCTION__, qty, 2);
+
+		// byte ranges are refused, as the transcoder cannot seek
+		is.close();
+		is.open("test_file_utf16.txt", 4, 100);
+		MYASSERT(__FUNCTION__, is.is_open(), false);
+		MYASSERT(__FUNCTION__, is.read_line(), false);
+	}
+
+	// a high surrogate and an odd byte at the end of the file are not dropped
+	{
+		std::ofstream out("test_file_utf16.txt", std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+		out.write("\xFF\xFEx\0,\0" "1\0\n\0y\0\x3D\xD8z", 15);
+	}
+	csv::ifstream truncated("test_file_utf16.txt");
+	MYASSERT(__FUNCTION__, truncated.read_line(), true);
+	MYASSERT(__FUNCTION__, truncated.get_line(), "x,1");
+	MYASSERT(__FUNCTION__, truncated.read_line(), true);
+	MYASSERT(__FUNCTION__, truncated.get_line(), "y\xEF\xBF\xBD\xEF\xBF\xBD");
+	MYASSERT(__FUNCTION__, truncated.read_line(), false);
+
+	const std::string text = "ok,\xC3\x28\n\xE2\x82\xAC,1\nbad,\xED\xA0\x80,\xF5";
+	csv::istringstream is(text.data(), text.size());
+	is.enable_utf8_validation(true);
+	int invalid_lines = 0;
+	while (is.read_line())
+	{
+		if (is.line_has_invalid_utf8())
+			++invalid_lines;
+	}
+	MYASSERT(__FUNCTION__, invalid_lines, 2);
+	MYASSERT(__FUNCTION__, is.encoding_error_count(), 3);
+	MYASSERT(__FUNCTION__, is.get_encoding_errors()[0].line, 1);
+	MYASSERT(__FUNCTION__, is.get_encoding_errors()[0].column, 4);
+	MYASSERT(__FUNCTION__, is.get_encoding_errors()[2].column, 9);
+	return true;
+}
+
+bool test_timestamp()
+{
+	const std::string text = "2024-02-29,1709164800\n2024-03-10T12:34:56.789+02:00,1710066896789\n2023-02-29,x\n";
+	csv::istringstream is(text.data(), text.size());
+	is.enable_error_collection(true);
+	csv::timestamp date;
+	csv::timestamp secs;
+	csv::timestamp millis(csv::timestamp::milliseconds);
+
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	is >> date >> secs;
+	MYASSERT(__FUNCTION__, date.epoch_seconds(), 1709164800);
+	bool same = (date == secs);
+	MYASSERT(__FUNCTION__, same, true);
+
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	is >> date >> millis;
+	MYASSERT(__FUNCTION__, date.epoch_millis(), 1710066896789LL);
+	MYASSERT(__FUNCTION__, date.offset_minutes(), 120);
+	same = (date == millis);
+	MYASSERT(__FUNCTION__, same, true);
+	const long long count = date.to_time_point<std::chrono::milliseconds>().time_since_epoch().count();
+	MYASSERT(__FUNCTION__, count, 1710066896789LL);
+
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	is >> date;
+	MYASSERT(__FUNCTION__, is.error_count(), 1);
+
+	csv::ostringstream os;
+	os << date << csv::timestamp::from_epoch(-1) << NEWLINE;
+	MYASSERT(__FUNCTION__, os.get_text(), "2024-03-10T10:34:56.789Z,1969-12-31T23:59:59Z\n");
+
+	csv::timestamp ts;
+	MYASSERT(__FUNCTION__, ts.parse("2024-03-10 10:34Z"), true);
+	MYASSERT(__FUNCTION__, ts.str(), "2024-03-10T10:34:00Z");
+	MYASSERT(__FUNCTION__, ts.parse("2024-03-10T10:34:00+05:"), false);
+	return true;
+}
+
+bool test_decimal()
+{
+	const std::string text = "19.99,0.125,0.125,-0.005\n1e5\n";
+	csv::istringstream is(text.data(), text.size());
+	is.enable_error_collection(true);
+	csv::decimal price(2);
+	csv::decimal rate;
+	csv::decimal rounded(2);
+	csv::decimal fee(2);
+
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	is >> price >> rate >> rounded >> fee;
+	MYASSERT(__FUNCTION__, price.mantissa(), 1999);
+	MYASSERT(__FUNCTION__, rate.mantissa(), 125);
+	MYASSERT(__FUNCTION__, rate.scale(), 3);
+	MYASSERT(__FUNCTION__, rounded.mantissa(), 13);
+	MYASSERT(__FUNCTION__, fee.str(), "-0.01");
+
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	is >> price;
+	MYASSERT(__FUNCTION__, is.error_count(), 1);
+	MYASSERT(__FUNCTION__, price.mantissa(), 1999);
+
+	csv::ostringstream os;
+	os << price << rate << csv::decimal::from_mantissa(5, 2) << NEWLINE;
+	MYASSERT(__FUNCTION__, os.get_text(), "19.99,0.125,0.05\n");
+
+	bool same = (csv::decimal::from_mantissa(15, 1) == csv::decimal::from_mantissa(150, 2));
+	MYASSERT(__FUNCTION__, same, true);
+	csv::decimal d = csv::decimal::from_mantissa(-1250, 3);
+	d.rescale(1);
+	MYASSERT(__FUNCTION__, d.str(), "-1.3");
+	return true;
+}
+
+bool test_checksum()
+{
+	uint64_t digest = csv::checksum::compute(csv::checksum::crc32c, "123456789", 9);
+	MYASSERT(__FUNCTION__, digest, 0xE3069283ULL);
+	digest = csv::checksum::compute(csv::checksum::xxhash64, "abc", 3);
+	MYASSERT(__FUNCTION__, digest, 0x44BC2CF5AD770999ULL);
+
+	char bytes[100];
+	for (int i = 0; i < 100; ++i)
+		bytes[i] = static_cast<char>(i);
+	csv::checksum sum(csv::checksum::xxhash64);
+	sum.update(bytes, 7);
+	sum.update(bytes + 7, 40);
+	sum.update(bytes + 47, 53);
+	digest = sum.digest();
+	MYASSERT(__FUNCTION__, digest, 0x6AC1E58032166597ULL);
+
+	const char* algos[] = { "crc32c", "xxhash64" };
+	for (int a = 0; a < 2; ++a)
+	{
+		const csv::checksum::algorithm algo = a == 0 ? csv::checksum::crc32c : csv::checksum::xxhash64;
+		const std::string text = "Apple,1\nBanana,2\nCherry,3";
+		{
+			csv::ofstream os("test_checksum.txt");
+			os.enable_checksum(true, algo, true);
+			os << "Apple" << 1 << NEWLINE;
+			digest = os.get_record_checksum();
+			MYASSERT(algos[a], digest, csv::checksum::compute(algo, "Apple,1\n", 8));
+			os << "Banana" << 2 << NEWLINE << "Cherry" << 3;
+			os.close();
+			digest = os.get_checksum();
+			MYASSERT(algos[a], digest, csv::checksum::compute(algo, text.data(), text.size()));
+		}
+		csv::ifstream is;
+		is.enable_checksum(true, algo, true);
+		is.open("test_checksum.txt");
+		is.skip_line();
+		MYASSERT(algos[a], is.read_line(), true);
+		digest = is.get_record_checksum();
+		MYASSERT(algos[a], digest, csv::checksum::compute(algo, "Banana,2\n", 9));
+		while (is.read_line()) {}
+		digest = is.get_record_checksum();
+		MYASSERT(algos[a], digest, csv::checksum::compute(algo, "Cherry,3", 8));
+		is.close();
+		digest = is.get_checksum();
+		MYASSERT(algos[a], digest, csv::checksum::compute(algo, text.data(), text.size()));
+	}
+	return true;
+}
+
+bool test_field_sink()
+{
+	const std::string blob(100, 'A');
+	const std::string text = "1," + blob + ",x\n2,,y\n3,BB,z\r\n";
+	{
+		std::ofstream out("test_field_sink.txt", std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+		out << text;
+	}
+	std::string received;
+	size_t chunks = 0;
+	size_t fields = 0;
+	csv::ifstream is;
+	is.enable_checksum(true);
+	is.set_field_sink(1, [&](const char* data, size_t size, bool last) {
+		received.append(data, size);
+		++chunks;
+		if (last)
+			++fields;
+	}, 16);
+	is.open("test_field_sink.txt");
+	int id = 0;
+	std::string empty, tag;
+	MYASSERT(__FUNCTION__, is.read_line(), true);
+	is >> id >> empty >> tag;
+	MYASSERT(__FUNCTION__, empty, "");
+	MYASSERT(__FUNCTION__, tag, "x");
+	MYASSERT(__FUNCTION__, received, blob);
+	MYASSERT(__FUNCTION__, chunks, 7);
+	while (is.read_line())
+		is >> id >> empty >> tag;
+	MYASSERT(__FUNCTION__, id, 3);
+	MYASSERT(__FUNCTION__, tag, "z");
+	MYASSERT(__FUNCTION__, fields, 3);
+	MYASSERT(__FUNCTION__, received, blob + "BB");
+	uint64_t digest = is.get_checksum();
+	MYASSERT(__FUNCTION__, digest, csv::checksum::compute(csv::checksum::crc32c, text.data(), text.size()));
+
+	// only the part of the line outside the sink counts towards the maximum line size
+	is.close();
+	is.set_max_line_size(8);
+	is.enable_error_collection(true);
+	is.open("test_field_sink.txt");
+	size_t lines = 0;
+	while (is.read_line())
+		++lines;
+	MYASSERT(__FUNCTION__, lines, 3);
+	MYASSERT(__FUNCTION__, is.error_count(), 0);
+
+	is.close();
+	is.clear_field_sink();
+	is.open("test_field_sink.txt");
+	lines = 0;
+	while (is.read_line())
+	{
+		is >> id;
+		++lines;
+	}
+	MYASSERT(__FUNCTION__, lines, 2);
+	MYASSERT(__FUNCTION__, id, 3);
+	MYASSERT(__FUNCTION__, is.error_count(), 1);
+	MYASSERT(__FUNCTION__, is.get_errors()[0].line, 1);
+	MYASSERT(__FUNCTION__, is.long_line_count(), 1);
+
+	// the quarantine gets a marker for a long line, and nothing is thrown without error collection
+	is.close();
+	std::ostringstream quarantine;
+	is.set_quarantine(&quarantine);
+	is.open("test_field_sink.txt");
+	while (is.read_line())
+		is >> id;
+	MYASSERT(__FUNCTION__, quarantine.str(), "# line 1 skipped: longer than 8 bytes\n");
+	is.close();
+	is.set_quarantine(NULL);
+	is.enable_error_collection(false);
+	is.open("test_field_sink.txt");
+	lines = 0;
+	while (is.read_line())
+		++lines;
+	MYASSERT(__FUNCTION__, lines, 2);
+	MYASSERT(__FUNCTION__, is.long_line_count(), 1);
+
+	// lines and fields longer than the read chunk
+	const std::string huge(200000, 'B');
+	{
+		std::ofstream out("test_field_sink.txt", std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+		out << "1," << huge << ",x\n2," << huge << "\n3,y,z\n";
+	}
+	is.close();
+	is.set_max_line_size(1000);
+	received.clear();
+	is.set_field_sink(1, [&](const char* data, size_t size, bool) { received.append(data, size); });
+	is.open("test_field_sink.txt");
+	lines = 0;
+	while (is.read_line())
+	{
+		is >> id >> empty >> tag;
+		++lines;
+	}
+	MYASSERT(__FUNCTION__, lines, 3);
+	MYASSERT(__FUNCTION__, tag, "z");
+	const bool all_received = (received == huge + huge + "y");
+	MYASSERT(__FUNCTION__, all_received, true);
+
+	is.close();
+	is.clear_field_sink();
+	is.open("test_field_sink.txt");
+	lines = 0;
+	while (is.read_line())
+	{
+		is >> id;
+		++lines;
+	}
+	MYASSERT(__FUNCTION__, lines, 1);
+	MYASSERT(__FUNCTION__, id, 3);
+	MYASSERT(__FUNCTION__, is.long_line_count(), 2);
+	const std::string huge_text = "1," + huge + ",x\n2," + huge + "\n3,y,z\n";
+	digest = is.get_checksum();
+	MYASSERT(__FUNCTION__, digest, csv::checksum::compute(csv::checksum::crc32c, huge_text.data(), huge_text.size()));
+
+	// a delimiter within quotes before the sink column does not start a column
+	const std::string blob2(100, 'C');
+	{
+		std::ofstream out("test_field_sink.txt", std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+		out << "\"a,b\"," << blob << ",x\n\"say \"\"c,d\"\"\"," << blob2 << ",y\n";
+	}
+	is.close();
+	is.set_max_line_size(20);
+	received.clear();
+	is.set_field_sink(1, [&](const char* data, size_t size, bool) { received.append(data, size); }, 16);
+	is.open("test_field_sink.txt");
+	lines = 0;
+	while (is.read_line())
+	{
+		is >> empty >> empty >> tag;
+		++lines;
+	}
+	MYASSERT(__FUNCTION__, lines, 2);
+	MYASSERT(__FUNCTION__, tag, "y");
+	MYASSERT(__FUNCTION__, is.long_line_count(), 0);
+	const bool sunk_blobs = (received == blob + blob2);
+	MYASSERT(__FUNCTION__, sunk_blobs, true);
+	return true;
+}
+
+// Rows of id and value with blank lines in between. Returns the line number that
+// csv::ifstream gives each id.
+std::vector<size_t> write_blank_line_file(const std::string& file, int rows)
+{
+	{
+		std::ofstream out(file.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+		out << "id,value\n";
+		for (int i = 1; i <= rows; ++i)
+		{
+			out << i << ',' << i * 2 << '\n';
+			if (i % 7 == 0)
+				out << '\n';
+			if (i % 50 == 0)
+				out << "\n\n";
+		}
+	}
+	std::vector<size_t> line_nums(rows + 1, 0);
+	csv::ifstream is(file);
+	is.enable_terminate_on_blank_line(false);
+	is.read_line();
+	int id = 0, value = 0;
+	while (is.read_line())
+	{
+		is >> id >> value;
+		line_nums[id] = is.get_line_num();
+	}
+	return line_nums;
+}
+
+bool test_row_dispatcher()
+{
+	{
+		csv::ofstream os("test_dispatch.txt");
+		os << "id" << "value" << NEWLINE;
+		for (int i = 1; i <= 5000; ++i)
+			os << i << i * 2 << NEWLINE;
+	}
+	const size_t consumers = 4;
+	std::vector<long long> sums(consumers, 0);
+	std::vector<size_t> rows(consumers, 0);
+	std::vector<size_t> bad_line_nums(consumers, 0);
+	csv::row_dispatcher dispatcher(consumers, 1024);
+	dispatcher.set_header(true);
+	bool ok = dispatcher.run("test_dispatch.txt", [&](csv::istringstream& is, size_t c) {
+		int id = 0, value = 0;
+		is >> id >> value;
+		sums[c] += value;
+		++rows[c];
+		if (is.get_line_num() != static_cast<size_t>(id) + 1)
+			++bad_line_nums[c];
+	});
+	MYASSERT(__FUNCTION__, ok, true);
+	MYASSERT(__FUNCTION__, dispatcher.get_header(), "id,value");
+	long long total = 0;
+	size_t row_total = 0, bad = 0;
+	for (size_t c = 0; c < consumers; ++c)
+	{
+		total += sums[c];
+		row_total += rows[c];
+		bad += bad_line_nums[c];
+	}
+	MYASSERT(__FUNCTION__, total, 5000LL * 5001);
+	MYASSERT(__FUNCTION__, row_total, 5000);
+	MYASSERT(__FUNCTION__, bad, 0);
+	const bool batched = dispatcher.batch_count() > 10;
+	MYASSERT(__FUNCTION__, batched, true);
+
+	bool thrown = false;
+	try
+	{
+		dispatcher.run("test_dispatch.txt", [](csv::istringstream& is, size_t) {
+			int id = 0;
+			is >> id;
+			if (id == 2500)
+				throw std::runtime_error("stop");
+		});
+	}
+	catch (std::runtime_error&)
+	{
+		thrown = true;
+	}
+	MYASSERT(__FUNCTION__, thrown, true);
+
+	// blank lines are skipped without a line number, as csv::ifstream does
+	const std::vector<size_t> expected = write_blank_line_file("test_dispatch.txt", 3000);
+	std::fill(bad_line_nums.begin(), bad_line_nums.end(), 0);
+	std::fill(rows.begin(), rows.end(), 0);
+	ok = dispatcher.run("test_dispatch.txt", [&](csv::istringstream& is, size_t c) {
+		int id = 0, value = 0;
+		is >> id >> value;
+		++rows[c];
+		if (is.get_line_num() != expected[id])
+			++bad_line_nums[c];
+	});
+	MYASSERT(__FUNCTION__, ok, true);
+	row_total = 0;
+	bad = 0;
+	for (size_t c = 0; c < consumers; ++c)
+	{
+		row_total += rows[c];
+		bad += bad_line_nums[c];
+	}
+	MYASSERT(__FUNCTION__, row_total, 3000);
+	MYASSERT(__FUNCTION__, bad, 0);
+	return true;
+}
+
+bool test_pipeline()
+{
+	{
+		csv::ofstream os("test_pipeline_in.txt");
+		os << "id" << "price" << NEWLINE;
+		for (int i = 1; i <= 3000; ++i)
+			os << i << i * 0.5 << NEWLINE;
+	}
+	for (int ordered = 0; ordered < 2; ++ordered)
+	{
+		csv::pipeline pipe(3, 512, 4);
+		pipe.set_header(true);
+		pipe.set_ordered(ordered == 1);
+		pipe.set_output_header("id,double_price");
+		bool ok = false;
+		{
+			csv::ofstream os("test_pipeline_out.txt");
+			ok = pipe.run("test_pipeline_in.txt", os, [](csv::istringstream& in, csv::ostringstream& out) {
+				int id = 0;
+				double price = 0.0;
+				in >> id >> price;
+				if (id % 3 != 0)
+					out << id << price * 2 << NEWLINE;
+			});
+		}
+		MYASSERT(__FUNCTION__, ok, true);
+		const bool batched = pipe.batch_count() > 10;
+		MYASSERT(__FUNCTION__, batched, true);
+
+		csv::ifstream is("test_pipeline_out.txt");
+		is.set_delimiter(',', "##");
+		std::string header;
+		MYASSERT(__FUNCTION__, is.read_line(), true);
+		header = is.get_line();
+		MYASSERT(__FUNCTION__, header, "id,double_price");
+		size_t rows = 0;
+		int id = 0, prev = 0;
+		double price = 0.0;
+		bool in_order = true;
+		long long id_total = 0;
+		while (is.read_line())
+		{
+			is >> id >> price;
+			if (id < prev)
+				in_order = false;
+			prev = id;
+			id_total += id;
+			++rows;
+		}
+		MYASSERT(__FUNCTION__, rows, 2000);
+		MYASSERT(__FUNCTION__, id_total, 3000LL * 3001 / 2 - 3LL * 1000 * 1001 / 2);
+		if (ordered)
+			MYASSERT(__FUNCTION__, in_order, true);
+	}
+
+	csv::pipeline pipe(2, 256);
+	bool thrown = false;
+	try
+	{
+		csv::ofstream os("test_pipeline_out.txt");
+		pipe.run("test_pipeline_in.txt", os, [](csv::istringstream& in, csv::ostringstream&) {
+			int id = 0;
+			in >> id;   // the header row is not skipped, so this throws
+		});
+	}
+	catch (std::runtime_error&)
+	{
+		thrown = true;
+	}
+	MYASSERT(__FUNCTION__, thrown, true);
+
+	// blank lines are skipped without a line number, as csv::ifstream does
+	const std::vector<size_t> expected = write_blank_line_file("test_pipeline_in.txt", 3000);
+	csv::pipeline numbered(3, 256, 4);
+	numbered.set_header(true);
+	bool ok = false;
+	{
+		csv::ofstream os("test_pipeline_out.txt");
+		ok = numbered.run("test_pipeline_in.txt", os, [](csv::istringstream& in, csv::ostringstream& out) {
+			int id = 0;
+			in >> id;
+			out << id << in.get_line_num() << NEWLINE;
+		});
+	}
+	MYASSERT(__FUNCTION__, ok, true);
+	csv::ifstream is("test_pipeline_out.txt");
+	size_t rows = 0, bad = 0;
+	while (is.read_line())
+	{
+		int id = 0;
+		size_t line_num = 0;
+		is >> id >> line_num;
+		if (line_num != expected[id])
+			++bad;
+		++rows;
+	}
+	MYASSERT(__FUNCTION__, rows, 3000);
+	MYASSERT(__FUNCTION__, bad, 0);
+
+	// tasks submitted by tasks all run before the pool is destroyed
+	std::atomic<int> done(0);
+	{
+		csv::work_stealing_pool pool(4);
+		for (int i = 0; i < 100; ++i)
+		{
+			pool.submit([&]() {
+				for (int k = 0; k < 10; ++k)
+					pool.submit([&]() { ++done; });
+				++done;
+			});
+		}
+	}
+	MYASSERT(__FUNCTION__, done.load(), 1100);
+	return true;
+}
@@ -1,5 +1,5 @@
 // The MIT License (MIT)
-// Minimalistic CSV Streams 1.8.7
+// Minimalistic CSV Streams 2.1.5
 // Copyright (C) 2014 - 2023, by Wong Shao Voon (shaovoon@yahoo.com)
 //
 // http://opensource.org/licenses/MIT
@@ -37,6 +37,32 @@
 // version 1.8.6  : Escape newlines when detected in the string input.
 // version 1.8.6b : Set visibility of some methods of istream_base from protected to public
 // version 1.8.7  : Add set_precision() for float formatting for output stream
+// version 1.9.0  : Zero-copy istringstream over caller-owned buffers. Tokenizer works on a view of the line
+// version 1.9.1  : ostringstream writes into a std::string: add reserve, take_text, clear and set_output_string
+// version 1.9.2  : Add variadic and tuple write_row which formats a whole row into one buffer
+// version 1.9.3  : Add enable_field_offsets for one-pass field offsets, field(k) and field_count
+// version 1.9.4  : Add dialect sniffer. Lines without quotes and escapes take a memchr fast path
+// version 1.9.5  : Add compile-time dialect policy and the fixed_ifstream, fixed_istringstream, fixed_ofstream and fixed_ostringstream
+// version 1.9.6  : Add parallel_writer which formats batches of rows on worker threads and writes them in order
+// version 1.9.7  : Add columnar_table which loads a CSV through a memory mapped binary columnar cache
+// version 1.9.8  : Add external_sorter for bounded-memory parallel sort of CSV files by key columns
+// version 1.9.9  : Add group_aggregator for streaming multi-threaded group-by aggregation
+// version 2.0.0  : Add hash_joiner for inner and left hash joins of two CSV files
+// version 2.0.1  : Add deduplicator with a bloom filter prefilter and spilling to disk
+// version 2.0.2  : Add row_view, and rows() coroutine generator on the readers for C++20
+// version 2.0.3  : Add row_iterator and rows_of() for std algorithms and C++20 ranges over rows
+// version 2.0.4  : Add follow mode on ifstream for tailing CSV files which are still being written
+// version 2.0.5  : Add byte range splits to ifstream, with offset and line number checkpoints
+// version 2.0.6  : Add error collection mode with an error log, counters and quarantine, and try_read
+// version 2.0.7  : Add delimiters of several characters to the readers and writers
+// version 2.0.8  : Add UTF-8 validation on the readers, and UTF-16 files transcoded to UTF-8 on ifstream
+// version 2.0.9  : Add timestamp type with a fixed layout ISO-8601 and epoch parser
+// version 2.1.0  : Add fixed-point decimal type which reads and writes exactly
+// version 2.1.1  : Add running CRC32C and XXH64 checksums of the bytes read by ifstream and written by ofstream
+// version 2.1.2  : Add field sink on ifstream for streaming a large field in chunks, and a maximum line size
+// version 2.1.3  : Add row_dispatcher which feeds batches of rows to consumer threads through a lock-free queue
+// version 2.1.4  : Add pipeline which runs read, transform and write stages on a work-stealing thread pool
+// version 2.1.5  : ostringstream::get_ostringstream returns a text_ostream instead of std::ostringstream, whose str() reads and replaces the text
 
 //#define USE_BOOST_LEXICAL_CAST
 
@@ -49,6 +75,62 @@
 #include <algorithm>
 #include <stdexcept>
 #include <iomanip>
+#include <cstring>
+#include <cstdio>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include <utility>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <cstdint>
+#include <iterator>
+#include <queue>
+#include <deque>
+#include <map>
+#include <memory>
+#include <functional>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+#include <sys/stat.h>
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#	define MINICSV_HAS_CPP17
+#	include <string_view>
+#endif
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#	if __has_include(<coroutine>)
+#		define MINICSV_HAS_COROUTINES
+#		include <coroutine>
+#	endif
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#	define MINICSV_HAS_POSIX
+#	include <sys/mman.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+#if defined(__SSE4_2__)
+#	define MINICSV_HAS_CRC32C_INSTR
+#	include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#	define MINICSV_HAS_CRC32C_INSTR
+#	include <arm_acle.h>
+#endif
+
+#if defined(__linux__)
+#	define MINICSV_HAS_INOTIFY
+#	include <sys/inotify.h>
+#	include <poll.h>
+#endif
 
 #ifdef USE_BOOST_LEXICAL_CAST
 #	include <boost/lexical_cast.hpp>
@@ -95,504 +177,4321 @@ namespace mini
 			return src;
 		}
 
-		class sep // separator class for the stream, so that no need to call set_delimiter
+		// Find needle in [hay, hay + n): memchr for the first byte, then verify the rest
+		inline const char* find_bytes(const char* hay, size_t n, const char* needle, size_t m)
 		{
-		public:
-			sep(const char delimiter_, const std::string& escape_) : delimiter(delimiter_), escape(escape_) {}
+			if (m == 0 || m > n)
+				return NULL;
 
-			const char get_delimiter() const { return delimiter; }
-			const std::string& get_escape() const { return escape; }
-		private:
-			const char delimiter;
-			const std::string escape;
-		};
+			const char* p = hay;
+			const char* const last = hay + (n - m);
+			while (p <= last)
+			{
+				p = static_cast<const char*>(memchr(p, needle[0], static_cast<size_t>(last - p) + 1));
+				if (p == NULL)
+					return NULL;
+				if (memcmp(p + 1, needle + 1, m - 1) == 0)
+					return p;
+				++p;
+			}
+			return NULL;
+		}
 
-		class istream_base
+		// FNV-1a hash, used to fingerprint files and records
+		inline uint64_t fnv1a(const char* data, size_t size, uint64_t hash = 14695981039346656037ULL)
 		{
-		public:
-			istream_base()
-				: pos(0)
-				, delimiter(",")
-				, unescape_str("##")
-				, trim_quote_on_str(false)
-				, trim_quote('\"')
-				, trim_quote_str(1, trim_quote)
-				, terminate_on_blank_line(true)
-				, quote_unescape("&quot;")
-				, newline_unescape("&newline;")
-				, line_num(0)
-				, token_num(0)
-				, allow_blank_line(false)
+			for (size_t i = 0; i < size; ++i)
 			{
+				hash ^= static_cast<unsigned char>(data[i]);
+				hash *= 1099511628211ULL;
 			}
-			void set_newline_unescape(std::string const& newline_unescape_)
+			return hash;
+		}
+
+		// Name for a temporary file next to file, unique across threads and processes
+		inline std::string unique_temp_name(const std::string& file)
+		{
+			static std::atomic<uint64_t> counter(0);
+			uint64_t id = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+			id = fnv1a(reinterpret_cast<const char*>(&id), sizeof(id), std::hash<std::thread::id>()(std::this_thread::get_id()));
+#ifdef MINICSV_HAS_POSIX
+			const uint64_t pid = static_cast<uint64_t>(getpid());
+			id = fnv1a(reinterpret_cast<const char*>(&pid), sizeof(pid), id);
+#endif
+			char buf[64];
+			snprintf(buf, sizeof(buf), ".%016llx.%llu.tmp", static_cast<unsigned long long>(id), static_cast<unsigned long long>(++counter));
+			return file + buf;
+		}
+
+		// Size and modification time of a file, returns false if it does not exist
+		// inode tells a rotated file from the original where the filesystem has them, it is 0 otherwise
+		inline bool file_stat(const std::string& file, uint64_t& size, int64_t& mtime, uint64_t& inode)
+		{
+#ifdef _MSC_VER
+			struct _stat64 st;
+			if (_stat64(file.c_str(), &st) != 0)
+				return false;
+#else
+			struct stat st;
+			if (stat(file.c_str(), &st) != 0)
+				return false;
+#endif
+			size = static_cast<uint64_t>(st.st_size);
+			mtime = static_cast<int64_t>(st.st_mtime);
+			inode = static_cast<uint64_t>(st.st_ino);
+			return true;
+		}
+		inline bool file_stat(const std::string& file, uint64_t& size, int64_t& mtime)
+		{
+			uint64_t inode = 0;
+			return file_stat(file, size, mtime, inode);
+		}
+
+		// Read-only view of a whole file: memory mapped where mmap is available, read otherwise
+		class mapped_file
+		{
+		public:
+			mapped_file() : ptr(NULL), len(0), mapped(false) {}
+			~mapped_file()
 			{
-				newline_unescape = newline_unescape_;
+				close();
 			}
-			std::string const& get_newline_unescape() const
+			bool open(const std::string& file)
 			{
-				return newline_unescape;
+				close();
+#ifdef MINICSV_HAS_POSIX
+				int fd = ::open(file.c_str(), O_RDONLY);
+				if (fd < 0)
+					return false;
+				struct stat st;
+				if (fstat(fd, &st) != 0)
+				{
+					::close(fd);
+					return false;
+				}
+				len = static_cast<size_t>(st.st_size);
+				if (len > 0)
+				{
+					void* p = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+					if (p == MAP_FAILED)
+					{
+						::close(fd);
+						len = 0;
+						return false;
+					}
+					ptr = static_cast<const char*>(p);
+					mapped = true;
+				}
+				::close(fd);
+				return true;
+#else
+				std::ifstream istm(file.c_str(), std::ios_base::in | std::ios_base::binary);
+				if (!istm.is_open())
+					return false;
+				buf.assign(std::istreambuf_iterator<char>(istm), std::istreambuf_iterator<char>());
+				ptr = buf.empty() ? NULL : &buf[0];
+				len = buf.size();
+				return true;
+#endif
 			}
-			// eof is replaced by read_line
-			//bool eof() const
-			void set_delimiter(char delimiter_, std::string const& unescape_str_)
+			void close()
 			{
-				delimiter = delimiter_;
-				unescape_str = unescape_str_;
+#ifdef MINICSV_HAS_POSIX
+				if (mapped)
+					munmap(const_cast<char*>(ptr), len);
+#else
+				std::vector<char>().swap(buf);
+#endif
+				ptr = NULL;
+				len = 0;
+				mapped = false;
 			}
-			std::string const& get_delimiter() const
+			const char* data() const { return ptr; }
+			size_t size() const { return len; }
+		private:
+			mapped_file(const mapped_file&);
+			mapped_file& operator=(const mapped_file&);
+
+			const char* ptr;
+			size_t len;
+			bool mapped;
+#ifndef MINICSV_HAS_POSIX
+			std::vector<char> buf;
+#endif
+		};
+
+		// Offset of the first invalid UTF-8 sequence in data, or size when there is none.
+		// Overlong forms, surrogates and code points above U+10FFFF are invalid. Runs of
+		// ASCII are skipped by testing 8 bytes at a time in a 64-bit word, other bytes are
+		// checked one sequence at a time; no SIMD instructions are used.
+		inline size_t utf8_invalid_at(const char* data, size_t size)
+		{
+			const unsigned char* s = reinterpret_cast<const unsigned char*>(data);
+			size_t i = 0;
+			while (i < size)
 			{
-				return delimiter;
+				while (i + 8 <= size)
+				{
+					uint64_t word;
+					memcpy(&word, s + i, sizeof(word));
+					if (word & 0x8080808080808080ULL)
+						break;
+					i += 8;
+				}
+				if (i >= size)
+					break;
+
+				const unsigned char c = s[i];
+				if (c < 0x80)
+				{
+					++i;
+					continue;
+				}
+				size_t need = 0;
+				unsigned char lo = 0x80, hi = 0xBF; // range of the second byte
+				if (c >= 0xC2 && c <= 0xDF)
+					need = 1;
+				else if (c >= 0xE0 && c <= 0xEF)
+				{
+					need = 2;
+					if (c == 0xE0)
+						lo = 0xA0;
+					else if (c == 0xED)
+						hi = 0x9F;
+				}
+				else if (c >= 0xF0 && c <= 0xF4)
+				{
+					need = 3;
+					if (c == 0xF0)
+						lo = 0x90;
+					else if (c == 0xF4)
+						hi = 0x8F;
+				}
+				else
+					return i;
+
+				if (i + need >= size || s[i + 1] < lo || s[i + 1] > hi)
+					return i;
+				for (size_t k = 2; k <= need; ++k)
+				{
+					if ((s[i + k] & 0xC0) != 0x80)
+						return i;
+				}
+				i += need + 1;
 			}
-			const std::string& get_delimited_str()
+			return size;
+		}
+
+		// Appends the UTF-8 form of the UTF-16 text in data to out. Returns the number of
+		// bytes used, which is less than size when data ends in the middle of a character.
+		// Unpaired surrogates become U+FFFD.
+		inline size_t utf16_to_utf8(const char* data, size_t size, bool big_endian, std::string& out)
+		{
+			const unsigned char* s = reinterpret_cast<const unsigned char*>(data);
+			size_t i = 0;
+			while (i + 2 <= size)
 			{
-				token = "";
-				char ch = '\0';
-				bool within_quote = false;
-				do
+				uint32_t cp = big_endian ? (uint32_t(s[i]) << 8 | s[i + 1]) : (uint32_t(s[i + 1]) << 8 | s[i]);
+				size_t used = 2;
+				if (cp >= 0xD800 && cp <= 0xDBFF)
 				{
-					if (pos >= this->str.size())
+					if (i + 4 > size)
+						break;
+					const uint32_t low = big_endian ? (uint32_t(s[i + 2]) << 8 | s[i + 3]) : (uint32_t(s[i + 3]) << 8 | s[i + 2]);
+					if (low >= 0xDC00 && low <= 0xDFFF)
 					{
-						this->str = "";
-
-						++token_num;
-						token = unescape(token);
-						return token;
+						cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+						used = 4;
 					}
+					else
+						cp = 0xFFFD;
+				}
+				else if (cp >= 0xDC00 && cp <= 0xDFFF)
+					cp = 0xFFFD;
 
-					ch = this->str[pos];
-					//if (trim_quote_on_str)
-					{
-						if (within_quote && ch == trim_quote && this->str[pos + 1] == trim_quote)
-						{
-							token += ch;
-							pos += 2;
-							continue;
-						}
-
-						if (within_quote == false && ch == trim_quote && ((pos > 0 && this->str[pos - 1] == delimiter[0]) || pos == 0))
-							within_quote = true;
-						else if (within_quote && ch == trim_quote)
-							within_quote = false;
-					}
+				if (cp < 0x80)
+					out += static_cast<char>(cp);
+				else if (cp < 0x800)
+				{
+					out += static_cast<char>(0xC0 | (cp >> 6));
+					out += static_cast<char>(0x80 | (cp & 0x3F));
+				}
+				else if (cp < 0x10000)
+				{
+					out += static_cast<char>(0xE0 | (cp >> 12));
+					out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+					out += static_cast<char>(0x80 | (cp & 0x3F));
+				}
+				else
+				{
+					out += static_cast<char>(0xF0 | (cp >> 18));
+					out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+					out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+					out += static_cast<char>(0x80 | (cp & 0x3F));
+				}
+				i += used;
+			}
+			return i;
+		}
 
-					++(pos);
+		// Input stream buffer which transcodes UTF-16 from another stream buffer to UTF-8,
+		// a block at a time
+		class utf16_transcoder : public std::streambuf
+		{
+		public:
+			utf16_transcoder() : src(NULL), big_endian(false) {}
+			void attach(std::streambuf* src_, bool big_endian_)
+			{
+				src = src_;
+				big_endian = big_endian_;
+				carry.clear();
+				out.clear();
+				setg(NULL, NULL, NULL);
+			}
+		protected:
+			int_type underflow()
+			{
+				if (gptr() < egptr())
+					return traits_type::to_int_type(*gptr());
 
-					if (ch == delimiter[0] && within_quote == false)
+				out.clear();
+				while (src && out.empty())
+				{
+					const size_t block = 64 * 1024;
+					const size_t kept = carry.size();
+					carry.resize(kept + block);
+					const std::streamsize n = src->sgetn(&carry[kept], static_cast<std::streamsize>(block));
+					carry.resize(kept + static_cast<size_t>(n > 0 ? n : 0));
+					if (n <= 0)
+					{
+						flush_carry();
 						break;
-					if (ch == '\r' || ch == '\n')
+					}
+					const size_t used = utf16_to_utf8(carry.data(), carry.size(), big_endian, out);
+					carry.erase(0, used);
+				}
+				if (out.empty())
+					return traits_type::eof();
+
+				char* p = &out[0];
+				setg(p, p, p + out.size());
+				return traits_type::to_int_type(*p);
+			}
+		private:
+			// At the end of the source, an odd byte and a high surrogate without its low
+			// half become U+FFFD each
+			void flush_carry()
+			{
+				while (!carry.empty())
+				{
+					carry.erase(0, utf16_to_utf8(carry.data(), carry.size(), big_endian, out));
+					if (carry.empty())
 						break;
+					out += "\xEF\xBF\xBD";
+					carry.erase(0, std::min<size_t>(2, carry.size()));
+				}
+			}
+			utf16_transcoder(const utf16_transcoder&);
+			utf16_transcoder& operator=(const utf16_transcoder&);
 
-					token += ch;
-				} while (true);
+			std::streambuf* src;
+			bool big_endian;
+			std::string carry;
+			std::string out;
+		};
 
-				++token_num;
-				token = unescape(token);
-				return token;
-			}
-			void enable_trim_quote_on_str(bool enable, char quote, const std::string& unescape = "&quot;")
+		// Running CRC32C or XXH64 of a byte stream. CRC32C uses the SSE4.2 or ARMv8 CRC
+		// instructions when the target has them, and slicing-by-8 tables otherwise.
+		class checksum
+		{
+		public:
+			enum algorithm { crc32c, xxhash64 };
+
+			explicit checksum(algorithm algo_ = crc32c) : algo(algo_)
 			{
-				trim_quote_on_str = enable;
-				trim_quote = quote;
-				trim_quote_str = std::string(1, trim_quote);
-				quote_unescape = unescape;
+				reset();
 			}
-			std::string get_rest_of_line() const
+			algorithm get_algorithm() const { return algo; }
+			void reset()
 			{
-				return str.substr(pos);
+				crc = 0xFFFFFFFFu;
+				acc[0] = prime1 + prime2;
+				acc[1] = prime2;
+				acc[2] = 0;
+				acc[3] = 0 - prime1;
+				total = 0;
+				stripe_len = 0;
 			}
-			void enable_blank_line(bool enable)
+			void update(const char* data, size_t size)
 			{
-				allow_blank_line = enable;
+				if (algo == crc32c)
+					crc = crc32c_update(crc, reinterpret_cast<const unsigned char*>(data), size);
+				else
+					xxh64_update(reinterpret_cast<const unsigned char*>(data), size);
 			}
-			std::string const& get_unescape_str() const
+			// CRC32C is in the low 32 bits
+			uint64_t digest() const
 			{
-				return unescape_str;
+				return (algo == crc32c) ? static_cast<uint64_t>(~crc) : xxh64_digest();
 			}
-			size_t num_of_delimiter() const
+			static uint64_t compute(algorithm algo_, const char* data, size_t size)
 			{
-				if (delimiter.size() == 0)
-					return 0;
-
-				size_t cnt = 0;
-				//if (trim_quote_on_str)
-				{
-					bool inside_quote = false;
-					for (size_t i = 0; i < str.size(); ++i)
-					{
-						if (str[i] == trim_quote)
-							inside_quote = !inside_quote;
+				checksum sum(algo_);
+				sum.update(data, size);
+				return sum.digest();
+			}
+		private:
+			static const uint64_t prime1 = 11400714785074694791ULL;
+			static const uint64_t prime2 = 14029467366897019727ULL;
+			static const uint64_t prime3 = 1609587929392839161ULL;
+			static const uint64_t prime4 = 9650029242287828579ULL;
+			static const uint64_t prime5 = 2870177450012600261ULL;
 
-						if (!inside_quote)
-						{
-							if (str[i] == delimiter[0])
-								++cnt;
-						}
-					}
-				}
-				return cnt;
+			static uint64_t load64(const unsigned char* p)
+			{
+				return static_cast<uint64_t>(load32(p)) | (static_cast<uint64_t>(load32(p + 4)) << 32);
 			}
-			const std::string& get_line() const
+			static uint32_t load32(const unsigned char* p)
 			{
-				return str;
+				return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8)
+					| (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
 			}
-			void enable_terminate_on_blank_line(bool enable)
+			static uint64_t rotl(uint64_t x, int r)
 			{
-				terminate_on_blank_line = enable;
+				return (x << r) | (x >> (64 - r));
 			}
-			bool is_terminate_on_blank_line() const
+			static uint64_t xxh64_round(uint64_t a, uint64_t input)
 			{
-				return terminate_on_blank_line;
+				return rotl(a + input * prime2, 31) * prime1;
 			}
-		protected:
-			std::string unescape(std::string& src)
+			static uint64_t xxh64_merge(uint64_t h, uint64_t a)
 			{
-				src = unescape_str.empty() ? src : replace(src, unescape_str, delimiter);
-
-				//if (trim_quote_on_str)
+				return (h ^ xxh64_round(0, a)) * prime1 + prime4;
+			}
+			void xxh64_update(const unsigned char* p, size_t size)
+			{
+				total += size;
+				if (stripe_len + size < sizeof(stripe))
 				{
-					if (!src.empty() && (src[0] == trim_quote && src[src.size() - 1] == trim_quote))
-					{
-						src = src.substr(1, src.size() - 2);
-					}
+					memcpy(stripe + stripe_len, p, size);
+					stripe_len += size;
+					return;
+				}
+				const unsigned char* end = p + size;
+				if (stripe_len > 0)
+				{
+					const size_t fill = sizeof(stripe) - stripe_len;
+					memcpy(stripe + stripe_len, p, fill);
+					p += fill;
+					for (int k = 0; k < 4; ++k)
+						acc[k] = xxh64_round(acc[k], load64(stripe + 8 * k));
+					stripe_len = 0;
+				}
+				for (; p + sizeof(stripe) <= end; p += sizeof(stripe))
+				{
+					for (int k = 0; k < 4; ++k)
+						acc[k] = xxh64_round(acc[k], load64(p + 8 * k));
+				}
+				stripe_len = static_cast<size_t>(end - p);
+				memcpy(stripe, p, stripe_len);
+			}
+			uint64_t xxh64_digest() const
+			{
+				uint64_t h;
+				if (total >= sizeof(stripe))
+				{
+					h = rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) + rotl(acc[3], 18);
+					for (int k = 0; k < 4; ++k)
+						h = xxh64_merge(h, acc[k]);
+				}
+				else
+				{
+					h = prime5;
+				}
+				h += total;
 
-					if (!newline_unescape.empty() && std::string::npos != src.find(newline_unescape, 0))
+				const unsigned char* p = stripe;
+				const unsigned char* end = stripe + stripe_len;
+				for (; p + 8 <= end; p += 8)
+					h = rotl(h ^ xxh64_round(0, load64(p)), 27) * prime1 + prime4;
+				if (p + 4 <= end)
+				{
+					h = rotl(h ^ (static_cast<uint64_t>(load32(p)) * prime1), 23) * prime2 + prime3;
+					p += 4;
+				}
+				for (; p < end; ++p)
+					h = rotl(h ^ (*p * prime5), 11) * prime1;
+
+				h ^= h >> 33;
+				h *= prime2;
+				h ^= h >> 29;
+				h *= prime3;
+				h ^= h >> 32;
+				return h;
+			}
+#ifdef MINICSV_HAS_CRC32C_INSTR
+			static uint32_t crc32c_update(uint32_t c, const unsigned char* p, size_t size)
+			{
+#	if defined(__SSE4_2__)
+#		if defined(__x86_64__) || defined(_M_X64)
+				uint64_t c64 = c;
+				for (; size >= 8; size -= 8, p += 8)
+					c64 = _mm_crc32_u64(c64, load64(p));
+				c = static_cast<uint32_t>(c64);
+#		endif
+				for (; size > 0; --size, ++p)
+					c = _mm_crc32_u8(c, *p);
+#	else
+				for (; size >= 8; size -= 8, p += 8)
+					c = __crc32cd(c, load64(p));
+				for (; size > 0; --size, ++p)
+					c = __crc32cb(c, *p);
+#	endif
+				return c;
+			}
+#else
+			struct crc32c_tables
+			{
+				crc32c_tables()
+				{
+					for (uint32_t i = 0; i < 256; ++i)
 					{
-						src = replace(src, newline_unescape, "\n");
+						uint32_t c = i;
+						for (int k = 0; k < 8; ++k)
+							c = (c >> 1) ^ (0x82F63B78u & (0u - (c & 1u)));
+						t[0][i] = c;
 					}
-
-					if (!quote_unescape.empty() && std::string::npos != src.find(quote_unescape, 0))
+					for (uint32_t i = 0; i < 256; ++i)
 					{
-						src = replace(src, quote_unescape, trim_quote_str);
+						for (int k = 1; k < 8; ++k)
+							t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
 					}
 				}
-
-				return src;
-			}
-		public:
-			std::string error_line(const std::string& token, const std::string& function_site)
+				uint32_t t[8][256];
+			};
+			static uint32_t crc32c_update(uint32_t c, const unsigned char* p, size_t size)
 			{
-				std::ostringstream is;
-				is << "csv::istream_base Conversion error at line no.:" << line_num
-					<< ", filename:" << filename << ", token position:" << token_num
-					<< ", token:" << token << ", function:" << function_site;
-
-				return is.str();
+				static const crc32c_tables tables;
+				const uint32_t (*t)[256] = tables.t;
+				for (; size >= 8; size -= 8, p += 8)
+				{
+					const uint32_t lo = c ^ load32(p);
+					const uint32_t hi = load32(p + 4);
+					c = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+						^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+				}
+				for (; size > 0; --size, ++p)
+					c = (c >> 8) ^ t[0][(c ^ *p) & 0xFF];
+				return c;
 			}
+#endif
 
-		protected:
-			std::string str;
-			size_t pos;
-			std::string delimiter;
-			std::string unescape_str;
-			bool trim_quote_on_str;
-			char trim_quote;
-			std::string trim_quote_str;
-			bool terminate_on_blank_line;
-			std::string quote_unescape;
-			std::string newline_unescape;
-			std::string filename;
-			size_t line_num;
-			size_t token_num;
-			std::string token;
-			bool allow_blank_line;
+			algorithm algo;
+			uint32_t crc;
+			uint64_t acc[4];
+			uint64_t total;
+			unsigned char stripe[32];
+			size_t stripe_len;
 		};
-		class ifstream : public istream_base
+
+		// Output streambuf which passes the bytes on to another streambuf and feeds them to a
+		// running checksum, and optionally to a checksum of each record ended by a newline
+		class checksum_buf : public std::streambuf
 		{
 		public:
-			ifstream(const std::string& file="")
-				: istream_base()
-				, has_bom(false)
-				, first_line_read(false)
+			checksum_buf() : dst(NULL), per_record(false), last_record(0) {}
+			void attach(std::streambuf* dst_, checksum::algorithm algo, bool per_record_)
 			{
-				open(file);
+				dst = dst_;
+				per_record = per_record_;
+				file_sum = checksum(algo);
+				record_sum = checksum(algo);
+				last_record = 0;
+				buf.resize(64 * 1024);
+				setp(&buf[0], &buf[0] + buf.size());
 			}
-			ifstream(const char * file)
-				: istream_base()
+			uint64_t digest() const
 			{
-				open(file);
+				return file_sum.digest();
 			}
-			void open(const std::string& file)
+			// Checksum of the record last ended by a newline which was passed on
+			uint64_t record_digest() const
 			{
-				if (!file.empty())
-					open(file.c_str());
+				return last_record;
 			}
-			void open(const char * file)
+			// Passes on the buffered bytes, without flushing the destination
+			bool drain()
 			{
-				init();
-				filename = file;
-				istm.open(file, std::ios_base::in);
-				read_bom();
-			}
-			void read_bom()
-			{
-				char tt[3] = { 0, 0, 0 };
-
-				istm.read(tt, sizeof(tt));
-
-				if (tt[0] == (char)0xEF || tt[1] == (char)0xBB || tt[2] == (char)0xBF) // not the correct BOM, so reset the pos to beginning (file might not have BOM)
-					has_bom = true;
-
-				istm.seekg(0, istm.beg);
-			}
-			void init()
-			{
-				str = "";
-				pos = 0;
-				delimiter = ',';
-				unescape_str = "##";
-				trim_quote_on_str = false;
-				trim_quote = '\"';
-				trim_quote_str = std::string(1, trim_quote);
-				terminate_on_blank_line = true;
-				has_bom = false;
-				first_line_read = false;
-				filename = "";
-				line_num = 0;
-				token_num = 0;
-				allow_blank_line = false;
+				const size_t n = static_cast<size_t>(pptr() - pbase());
+				if (n == 0)
+					return true;
+				consume(pbase(), n);
+				const bool ok = dst->sputn(pbase(), static_cast<std::streamsize>(n)) == static_cast<std::streamsize>(n);
+				setp(&buf[0], &buf[0] + buf.size());
+				return ok;
 			}
-			void close()
+		protected:
+			virtual int_type overflow(int_type c)
 			{
-				istm.close();
+				if (!drain())
+					return traits_type::eof();
+				if (!traits_type::eq_int_type(c, traits_type::eof()))
+				{
+					*pptr() = traits_type::to_char_type(c);
+					pbump(1);
+				}
+				return traits_type::not_eof(c);
 			}
-			bool is_open()
+			virtual int sync()
 			{
-				return istm.is_open();
+				return (drain() && dst->pubsync() == 0) ? 0 : -1;
 			}
-			void skip_line()
+		private:
+			checksum_buf(const checksum_buf&);
+			checksum_buf& operator=(const checksum_buf&);
+
+			void consume(const char* p, size_t n)
 			{
-				if (!istm.eof())
+				file_sum.update(p, n);
+				if (!per_record)
+					return;
+				const char* end = p + n;
+				while (p < end)
 				{
-					std::getline(istm, str);
-					pos = 0;
-
-					if (first_line_read == false)
+					const char* nl = static_cast<const char*>(memchr(p, NEWLINE, static_cast<size_t>(end - p)));
+					const char* stop = nl ? nl + 1 : end;
+					record_sum.update(p, static_cast<size_t>(stop - p));
+					if (nl)
 					{
-						first_line_read = true;
+						last_record = record_sum.digest();
+						record_sum.reset();
 					}
+					p = stop;
 				}
 			}
-			bool read_line()
-			{
-				this->str = "";
-				while (!istm.eof())
-				{
-					std::getline(istm, this->str);
-					pos = 0;
 
-					if (first_line_read == false)
-					{
-						first_line_read = true;
-						if (has_bom)
-						{
-							this->str = this->str.substr(3);
-						}
-					}
+			std::streambuf* dst;
+			bool per_record;
+			checksum file_sum;
+			checksum record_sum;
+			uint64_t last_record;
+			std::vector<char> buf;
+		};
 
-					if (this->str.empty())
-					{
-						if (terminate_on_blank_line)
-							break;
-						else if (allow_blank_line == false)
-							continue;
-					}
+		// Invalid UTF-8 found by a reader with UTF-8 validation enabled
+		struct encoding_error
+		{
+			encoding_error(size_t line_, size_t column_) : line(line_), column(column_) {}
+			size_t line;
+			size_t column; // 1-based byte position in the line
+		};
 
-					++line_num;
-					token_num = 0;
-					return true;
-				}
-				return false;
-			}
+		class sep // separator class for the stream, so that no need to call set_delimiter
+		{
+		public:
+			sep(const char delimiter_, const std::string& escape_) : delimiter(1, delimiter_), escape(escape_) {}
+			sep(const std::string& delimiter_, const std::string& escape_) : delimiter(delimiter_), escape(escape_) {}
 
+			const char get_delimiter() const { return delimiter.empty() ? '\0' : delimiter[0]; }
+			const std::string& get_delimiter_str() const { return delimiter; }
+			const std::string& get_escape() const { return escape; }
 		private:
-			std::ifstream istm;
-			bool has_bom;
-			bool first_line_read;
-			std::string filename;
+			const std::string delimiter;
+			const std::string escape;
 		};
-		class ostream_base
+
+		// Point in time kept as seconds and nanoseconds since 1970-01-01T00:00:00Z. It is read
+		// from a fixed layout without going through std::istream or strptime:
+		//   YYYY-MM-DD
+		//   YYYY-MM-DDThh:mm[:ss[.fraction]][Z|+hh:mm|-hh:mm|+hhmm|+hh]   ('T' or a space)
+		//   [-]digits   epoch count in the unit given to the constructor
+		// It is written as YYYY-MM-DDThh:mm:ss[.fraction]Z in UTC.
+		class timestamp
 		{
 		public:
-			ostream_base()
-				: after_newline(true)
-				, delimiter(",")
-				, escape_str("##")
-				, surround_quote_on_str(false)
-				, surround_quote('\"')
-				, quote_escape("&quot;")
-				, newline_escape("&newline;")
-				, precision(0)
-			{
-			}
-		public:
-			void enable_surround_quote_on_str(bool enable, char quote, const std::string& escape = "&quot;")
+			enum epoch_unit { seconds, milliseconds, microseconds, nanoseconds };
+			enum { max_text = 40 };
+
+			explicit timestamp(epoch_unit unit_ = seconds) : secs(0), nanos(0), offset(0), unit(unit_) {}
+
+			static timestamp from_epoch(int64_t count, epoch_unit unit_ = seconds)
 			{
-				surround_quote_on_str = enable;
-				surround_quote = quote;
-				quote_escape = escape;
+				timestamp ts(unit_);
+				ts.set_epoch(count);
+				return ts;
 			}
-			void set_newline_escape(std::string const& newline_escape_)
+			static timestamp from_civil(int64_t year, unsigned month, unsigned day,
+				unsigned hour = 0, unsigned minute = 0, unsigned second = 0, uint32_t nanosecond = 0)
 			{
-				newline_escape = newline_escape_;
+				timestamp ts;
+				ts.secs = days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+				ts.nanos = nanosecond;
+				return ts;
 			}
-			std::string const& get_newline_escape() const
+
+			int64_t epoch_seconds() const { return secs; }
+			int64_t epoch_millis() const { return secs * 1000 + nanos / 1000000; }
+			int64_t epoch_micros() const { return secs * 1000000 + nanos / 1000; }
+			int64_t epoch_nanos() const { return secs * 1000000000 + nanos; }
+			uint32_t nanosecond() const { return nanos; }
+			// UTC offset in minutes written in the parsed text, 0 for Z and epoch counts
+			int offset_minutes() const { return offset; }
+			epoch_unit get_unit() const { return unit; }
+			void set_unit(epoch_unit unit_) { unit = unit_; }
+
+			template<typename Duration = std::chrono::system_clock::duration>
+			std::chrono::time_point<std::chrono::system_clock, Duration> to_time_point() const
 			{
-				return newline_escape;
+				return std::chrono::time_point<std::chrono::system_clock, Duration>(
+					std::chrono::duration_cast<Duration>(std::chrono::seconds(secs) + std::chrono::nanoseconds(nanos)));
 			}
-			void set_delimiter(char delimiter_, std::string const& escape_str_)
+
+			// Returns false and leaves the value unchanged when the text does not match a layout
+			bool parse(const char* s, size_t len)
 			{
-				delimiter = delimiter_;
-				escape_str = escape_str_;
+				if (len == 0)
+					return false;
+				size_t i = (s[0] == '-') ? 1 : 0;
+				while (i < len && is_digit(s[i]))
+					++i;
+				if (i == len)
+					return parse_epoch(s, len);
+				return parse_iso(s, len);
 			}
-			std::string const& get_delimiter() const
+			bool parse(const std::string& text)
 			{
-				return delimiter;
+				return parse(text.data(), text.size());
 			}
-			void set_after_newline(bool after_newline_)
+
+			// Writes at most max_text characters to buf and returns the length, no terminator
+			size_t format(char* buf) const
 			{
-				after_newline = after_newline_;
+				int64_t days = secs / 86400;
+				int64_t rem = secs % 86400;
+				if (rem < 0)
+				{
+					rem += 86400;
+					--days;
+				}
+				int64_t year;
+				unsigned month, day;
+				civil_from_days(days, year, month, day);
+
+				size_t n = 0;
+				if (year >= 0 && year <= 9999)
+				{
+					put_digits(buf, n, static_cast<uint32_t>(year), 4);
+				}
+				else
+				{
+					char ybuf[24];
+					int ylen = snprintf(ybuf, sizeof(ybuf), "%lld", static_cast<long long>(year));
+					memcpy(buf, ybuf, static_cast<size_t>(ylen));
+					n = static_cast<size_t>(ylen);
+				}
+				buf[n++] = '-';
+				put_digits(buf, n, month, 2);
+				buf[n++] = '-';
+				put_digits(buf, n, day, 2);
+				buf[n++] = 'T';
+				put_digits(buf, n, static_cast<uint32_t>(rem / 3600), 2);
+				buf[n++] = ':';
+				put_digits(buf, n, static_cast<uint32_t>(rem / 60 % 60), 2);
+				buf[n++] = ':';
+				put_digits(buf, n, static_cast<uint32_t>(rem % 60), 2);
+				if (nanos != 0)
+				{
+					buf[n++] = '.';
+					if (nanos % 1000000 == 0)
+						put_digits(buf, n, nanos / 1000000, 3);
+					else if (nanos % 1000 == 0)
+						put_digits(buf, n, nanos / 1000, 6);
+					else
+						put_digits(buf, n, nanos, 9);
+				}
+				buf[n++] = 'Z';
+				return n;
 			}
-			bool get_after_newline() const
+			std::string str() const
 			{
-				return after_newline;
+				char buf[max_text];
+				return std::string(buf, format(buf));
 			}
-			void set_precision(int precision_)
+
+			friend bool operator==(const timestamp& a, const timestamp& b) { return a.secs == b.secs && a.nanos == b.nanos; }
+			friend bool operator!=(const timestamp& a, const timestamp& b) { return !(a == b); }
+			friend bool operator<(const timestamp& a, const timestamp& b) { return a.secs < b.secs || (a.secs == b.secs && a.nanos < b.nanos); }
+			friend std::istream& operator>>(std::istream& is, timestamp& ts)
 			{
-				precision = precision_;
+				std::string text;
+				if (is >> text && !ts.parse(text))
+					is.setstate(std::ios_base::failbit);
+				return is;
 			}
-			int get_precision()
+			friend std::ostream& operator<<(std::ostream& os, const timestamp& ts)
 			{
-				return precision;
+				char buf[max_text];
+				os.write(buf, static_cast<std::streamsize>(ts.format(buf)));
+				return os;
 			}
-			void reset_precision()
+
+			// Days since 1970-01-01 in the proleptic Gregorian calendar
+			static int64_t days_from_civil(int64_t y, unsigned m, unsigned d)
 			{
-				precision = 0;
+				y -= m <= 2;
+				const int64_t era = (y >= 0 ? y : y - 399) / 400;
+				const int64_t yoe = y - era * 400;
+				const int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+				const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+				return era * 146097 + doe - 719468;
 			}
-		protected:
-			std::string const& get_escape_str() const
+			static void civil_from_days(int64_t z, int64_t& y, unsigned& m, unsigned& d)
 			{
-				return escape_str;
+				z += 719468;
+				const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+				const int64_t doe = z - era * 146097;
+				const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+				const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+				const int64_t mp = (5 * doy + 2) / 153;
+				d = static_cast<unsigned>(doy - (153 * mp + 2) / 5 + 1);
+				m = static_cast<unsigned>(mp < 10 ? mp + 3 : mp - 9);
+				y = yoe + era * 400 + (m <= 2);
 			}
-		protected:
-			bool after_newline;
-			std::string delimiter;
-			std::string escape_str;
-			bool surround_quote_on_str;
-			char surround_quote;
-			std::string quote_escape;
-			std::string newline_escape;
-			int precision;
-		};
-		class ofstream : public ostream_base
-		{
-		public:
-
-			ofstream(const std::string& file = "")
-				: ostream_base()
+		private:
+			static bool is_digit(char c)
 			{
-				open(file);
+				return c >= '0' && c <= '9';
 			}
-			ofstream(const char * file)
-				: ostream_base()
+			// Reads n digits at s + i into val
+			static bool get_digits(const char* s, size_t len, size_t i, size_t n, unsigned& val)
 			{
-				open(file);
+				if (i + n > len)
+					return false;
+				val = 0;
+				for (size_t k = i; k < i + n; ++k)
+				{
+					if (!is_digit(s[k]))
+						return false;
+					val = val * 10 + (s[k] - '0');
+				}
+				return true;
 			}
-			void open(const std::string& file)
+			static void put_digits(char* buf, size_t& n, uint32_t val, size_t width)
 			{
-				if (!file.empty())
-					open(file.c_str());
+				for (size_t k = width; k > 0; --k)
+				{
+					buf[n + k - 1] = static_cast<char>('0' + val % 10);
+					val /= 10;
+				}
+				n += width;
 			}
-			void open(const char * file)
+			static unsigned days_in_month(int64_t y, unsigned m)
 			{
-				init();
-				ostm.open(file, std::ios_base::out);
+				static const unsigned days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+				if (m == 2 && (y % 4 == 0 && (y % 100 != 0 || y % 400 == 0)))
+					return 29;
+				return days[m - 1];
 			}
-			void init()
+			void set_epoch(int64_t count)
 			{
-				after_newline = true;
-				delimiter = ',';
-				escape_str = "##";
-				surround_quote_on_str = false;
-				surround_quote = '\"';
-				quote_escape = "&quot;";
-				precision = 0;
+				static const int64_t per_second[] = { 1, 1000, 1000000, 1000000000 };
+				const int64_t per = per_second[unit];
+				int64_t s = count / per;
+				int64_t r = count % per;
+				if (r < 0)
+				{
+					r += per;
+					--s;
+				}
+				secs = s;
+				nanos = static_cast<uint32_t>(r * (1000000000 / per));
+				offset = 0;
 			}
-			void flush()
+			bool parse_epoch(const char* s, size_t len)
 			{
-				ostm.flush();
+				const bool negative = (s[0] == '-');
+				size_t i = negative ? 1 : 0;
+				if (i == len || len - i > 19)
+					return false;
+				uint64_t v = 0;
+				for (; i < len; ++i)
+					v = v * 10 + (s[i] - '0');
+				if (v > static_cast<uint64_t>(INT64_MAX))
+					return false;
+				const int64_t count = static_cast<int64_t>(v);
+				set_epoch(negative ? -count : count);
+				return true;
 			}
-			void close()
+			bool parse_iso(const char* s, size_t len)
 			{
-				ostm.close();
+				unsigned year, month, day;
+				if (!get_digits(s, len, 0, 4, year) || len < 10 || s[4] != '-' || s[7] != '-'
+					|| !get_digits(s, len, 5, 2, month) || !get_digits(s, len, 8, 2, day))
+					return false;
+				if (month < 1 || month > 12 || day < 1 || day > days_in_month(year, month))
+					return false;
+
+				unsigned hour = 0, minute = 0, second = 0;
+				uint32_t frac = 0;
+				int off = 0;
+				size_t i = 10;
+				if (i < len)
+				{
+					if (s[i] != 'T' && s[i] != 't' && s[i] != ' ')
+						return false;
+					if (!get_digits(s, len, 11, 2, hour) || len < 14 || s[13] != ':' || !get_digits(s, len, 14, 2, minute))
+						return false;
+					i = 16;
+					if (i < len && s[i] == ':')
+					{
+						if (!get_digits(s, len, 17, 2, second))
+							return false;
+						i = 19;
+						if (i < len && (s[i] == '.' || s[i] == ','))
+						{
+							++i;
+							size_t digits = 0;
+							uint32_t scale = 100000000;
+							for (; i < len && is_digit(s[i]); ++i, ++digits)
+							{
+								// digits past nanoseconds are dropped
+								frac += (s[i] - '0') * scale;
+								scale /= 10;
+							}
+							if (digits == 0)
+								return false;
+						}
+					}
+					if (hour > 23 || minute > 59 || second > 60)
+						return false;
+					if (i < len)
+					{
+						if (s[i] == 'Z' || s[i] == 'z')
+						{
+							++i;
+						}
+						else if (s[i] == '+' || s[i] == '-')
+						{
+							const int sign = (s[i] == '-') ? -1 : 1;
+							unsigned oh = 0, om = 0;
+							if (!get_digits(s, len, i + 1, 2, oh))
+								return false;
+							i += 3;
+							const bool colon = (i < len && s[i] == ':');
+							if (colon)
+								++i;
+							if (colon || i < len)
+							{
+								if (!get_digits(s, len, i, 2, om))
+									return false;
+								i += 2;
+							}
+							if (oh > 23 || om > 59)
+								return false;
+							off = sign * static_cast<int>(oh * 60 + om);
+						}
+					}
+					if (i != len)
+						return false;
+				}
+				secs = days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second - off * 60;
+				nanos = frac;
+				offset = off;
+				return true;
 			}
-			bool is_open()
+
+			int64_t secs;
+			uint32_t nanos;
+			int offset;
+			epoch_unit unit;
+		};
+
+		// Fixed-point number of an int64 mantissa and a count of fraction digits, for money
+		// columns which must round-trip exactly. A decimal constructed with a scale reads every
+		// value to that scale, rounding half away from zero; a default constructed one keeps
+		// the scale written in the text. Exponents are not accepted.
+		class decimal
+		{
+		public:
+			enum { max_scale = 18, max_text = 24 };
+
+			decimal() : mant(0), digits(0), fixed(false) {}
+			explicit decimal(int scale_) : mant(0), digits(clamp_scale(scale_)), fixed(true) {}
+
+			static decimal from_mantissa(int64_t mantissa_, int scale_)
 			{
-				return ostm.is_open();
+				decimal d(scale_);
+				d.mant = mantissa_;
+				return d;
 			}
-			std::ofstream& get_ofstream()
+
+			int64_t mantissa() const { return mant; }
+			int scale() const { return digits; }
+			bool has_fixed_scale() const { return fixed; }
+			double to_double() const
 			{
-				return ostm;
+				return static_cast<double>(mant) / static_cast<double>(pow10(digits));
 			}
-			void escape_and_output(std::string src)
+
+			// Changes the scale, rounding half away from zero when digits are dropped.
+			// Returns false and leaves the value unchanged when the mantissa would overflow.
+			bool rescale(int scale_)
 			{
-				ostm << ((escape_str.empty()) ? src : replace(src, delimiter, escape_str));
+				scale_ = clamp_scale(scale_);
+				int64_t m = mant;
+				if (scale_ > digits)
+				{
+					const int64_t p = static_cast<int64_t>(pow10(scale_ - digits));
+					if (m > INT64_MAX / p || m < -INT64_MAX / p)
+						return false;
+					m *= p;
+				}
+				else if (scale_ < digits)
+				{
+					const int64_t p = static_cast<int64_t>(pow10(digits - scale_));
+					const int64_t r = m % p;
+					m /= p;
+					if (r >= p - r)
+						++m;
+					else if (-r >= p + r)
+						--m;
+				}
+				mant = m;
+				digits = scale_;
+				return true;
 			}
-			void escape_str_and_output(std::string src)
+
+			// Returns false and leaves the value unchanged when the text is not a plain decimal
+			// number or does not fit in the mantissa
+			bool parse(const char* s, size_t len)
 			{
-				src = ((escape_str.empty()) ? src : replace(src, delimiter, escape_str));
-				if (!newline_escape.empty())
+				size_t i = 0;
+				bool negative = false;
+				if (i < len && (s[i] == '-' || s[i] == '+'))
+				{
+					negative = (s[i] == '-');
+					++i;
+				}
+				const int target = fixed ? digits : static_cast<int>(max_scale);
+				uint64_t v = 0;
+				size_t digit_count = 0;
+				for (; i < len && is_digit(s[i]); ++i, ++digit_count)
 				{
-					src = replace(src, std::string(1, '\n'), newline_escape);
+					if (!mul_add(v, 10, static_cast<uint64_t>(s[i] - '0')))
+						return false;
 				}
-				if (surround_quote_on_str || src.find(delimiter) != std::string::npos)
+				int kept = 0;
+				bool round_up = false;
+				if (i < len && s[i] == '.')
 				{
-					if (!quote_escape.empty())
+					bool dropped = false;
+					for (++i; i < len && is_digit(s[i]); ++i, ++digit_count)
 					{
-						src = replace(src, std::string(1, surround_quote), quote_escape);
+						if (kept < target)
+						{
+							if (!mul_add(v, 10, static_cast<uint64_t>(s[i] - '0')))
+								return false;
+							++kept;
+						}
+						else if (!dropped)
+						{
+							dropped = true;
+							round_up = (s[i] >= '5');
+						}
 					}
-					ostm << surround_quote << src << surround_quote;
 				}
-				else
+				if (digit_count == 0 || i != len)
+					return false;
+				if (round_up && !mul_add(v, 1, 1))
+					return false;
+				if (fixed && kept < target && !mul_add(v, pow10(target - kept), 0))
+					return false;
+
+				mant = negative ? -static_cast<int64_t>(v) : static_cast<int64_t>(v);
+				if (!fixed)
+					digits = kept;
+				return true;
+			}
+			bool parse(const std::string& text)
+			{
+				return parse(text.data(), text.size());
+			}
+
+			// Writes at most max_text characters to buf and returns the length, no terminator
+			size_t format(char* buf) const
+			{
+				uint64_t v = mant < 0 ? 0 - static_cast<uint64_t>(mant) : static_cast<uint64_t>(mant);
+				char rev[max_text];
+				size_t t = 0;
+				do
 				{
-					ostm << src;
+					rev[t++] = static_cast<char>('0' + v % 10);
+					v /= 10;
+				} while (v != 0 || t <= static_cast<size_t>(digits));
+
+				size_t n = 0;
+				if (mant < 0)
+					buf[n++] = '-';
+				while (t > 0)
+				{
+					buf[n++] = rev[--t];
+					if (t == static_cast<size_t>(digits) && t > 0)
+						buf[n++] = '.';
 				}
+				return n;
+			}
+			std::string str() const
+			{
+				char buf[max_text];
+				return std::string(buf, format(buf));
 			}
-		private:
-			std::ofstream ostm;
-		};
 
+			// Compares values, so 1.5 equals 1.50
+			friend bool operator==(const decimal& a, const decimal& b) { return compare(a, b) == 0; }
+			friend bool operator!=(const decimal& a, const decimal& b) { return compare(a, b) != 0; }
+			friend bool operator<(const decimal& a, const decimal& b) { return compare(a, b) < 0; }
+			friend std::istream& operator>>(std::istream& is, decimal& d)
+			{
+				std::string text;
+				if (is >> text && !d.parse(text))
+					is.setstate(std::ios_base::failbit);
+				return is;
+			}
+			friend std::ostream& operator<<(std::ostream& os, const decimal& d)
+			{
+				char buf[max_text];
+				os.write(buf, static_cast<std::streamsize>(d.format(buf)));
+				return os;
+			}
+		private:
+			static bool is_digit(char c)
+			{
+				return c >= '0' && c <= '9';
+			}
+			static int clamp_scale(int scale_)
+			{
+				return scale_ < 0 ? 0 : (scale_ > max_scale ? static_cast<int>(max_scale) : scale_);
+			}
+			static uint64_t pow10(int n)
+			{
+				static const uint64_t table[] = { 1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+					10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+					10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+					100000000000000000ULL, 1000000000000000000ULL };
+				return table[n];
+			}
+			// v = v * mul + add, false when the result is past INT64_MAX
+			static bool mul_add(uint64_t& v, uint64_t mul, uint64_t add)
+			{
+				const uint64_t limit = static_cast<uint64_t>(INT64_MAX);
+				if (v > (limit - add) / mul)
+					return false;
+				v = v * mul + add;
+				return true;
+			}
+			static int compare(const decimal& a, const decimal& b)
+			{
+				decimal x = a;
+				decimal y = b;
+				const int s = a.digits > b.digits ? a.digits : b.digits;
+				if (!x.rescale(s) || !y.rescale(s))
+				{
+					const double dx = a.to_double();
+					const double dy = b.to_double();
+					return dx < dy ? -1 : (dy < dx ? 1 : 0);
+				}
+				return x.mant < y.mant ? -1 : (y.mant < x.mant ? 1 : 0);
+			}
 
-	} // ns csv
-} // ns mini
+			int64_t mant;
+			int digits;
+			bool fixed;
+		};
 
-template<typename T>
-mini::csv::ifstream& operator >> (mini::csv::ifstream& istm, T& val)
-{
-	const std::string& str = istm.get_delimited_str();
+		// Non-owning view of characters in the current line, valid until the next read_line
+		class field_view
+		{
+		public:
+			field_view() : ptr(""), len(0) {}
+			field_view(const char* ptr_, size_t len_) : ptr(ptr_), len(len_) {}
+
+			const char* data() const { return ptr; }
+			size_t size() const { return len; }
+			bool empty() const { return len == 0; }
+			const char* begin() const { return ptr; }
+			const char* end() const { return ptr + len; }
+			char operator[](size_t i) const { return ptr[i]; }
+			std::string to_string() const { return std::string(ptr, len); }
+#ifdef MINICSV_HAS_CPP17
+			operator std::string_view() const { return std::string_view(ptr, len); }
+#endif
+			bool operator==(const field_view& other) const
+			{
+				return len == other.len && (len == 0 || memcmp(ptr, other.ptr, len) == 0);
+			}
+			bool operator!=(const field_view& other) const
+			{
+				return !(*this == other);
+			}
+		private:
+			const char* ptr;
+			size_t len;
+		};
+
+		enum class escape { none, strings };
+
+		// Compile-time dialect policy for the fixed_* streams. A Quote of '\0' disables quoting.
+		// escape::none means RFC 4180 style: only quoting and doubled quotes, no escape strings.
+		template<char Delim, char Quote = '\"', escape Esc = escape::strings>
+		struct dialect
+		{
+			char delimiter() const { return Delim; }
+			size_t delimiter_size() const { return 1; }
+			const char* delimiter_str() const
+			{
+				static const char str[2] = { Delim, '\0' };
+				return str;
+			}
+			char quote() const { return Quote; }
+			bool has_quote() const { return Quote != '\0'; }
+			bool has_escape() const { return Esc == escape::strings; }
+		};
+
+		// Default policy: delimiter and quote are the stream settings, escape strings are applied.
+		// The delimiter may be several characters long; delimiter() is its first one.
+		class runtime_dialect
+		{
+		public:
+			runtime_dialect(const std::string& delimiter_, char quote_)
+				: delim(delimiter_.c_str()), delim_size(delimiter_.empty() ? 1 : delimiter_.size()), q(quote_) {}
+			char delimiter() const { return delim[0]; }
+			size_t delimiter_size() const { return delim_size; }
+			const char* delimiter_str() const { return delim; }
+			char quote() const { return q; }
+			bool has_quote() const { return true; }
+			bool has_escape() const { return true; }
+		private:
+			const char* delim;
+			size_t delim_size;
+			char q;
+		};
+
+		// Dialect description returned by the sniffer, see istream_base::sniff_text
+		struct dialect_info
+		{
+			enum column_type { empty_column, integer_column, float_column, text_column };
+
+			dialect_info()
+				: delimiter(',')
+				, quote('\"')
+				, has_quotes(false)
+				, has_escapes(false)
+				, has_header(false)
+				, column_count(0)
+			{
+			}
+			char delimiter;
+			char quote;
+			bool has_quotes;	// the quote character occurs in the sample
+			bool has_escapes;	// one of the unescape strings occurs in the sample
+			bool has_header;	// first row is text where the other rows have numbers
+			size_t column_count;
+			std::vector<column_type> column_types;
+		};
+
+		// Conversion error recorded by a reader in error collection mode
+		struct parse_error
+		{
+			parse_error(size_t line_, size_t token_pos_, const std::string& token_, const std::string& site_)
+				: line(line_), token_pos(token_pos_), token(token_), site(site_) {}
+			size_t line;
+			size_t token_pos;
+			std::string token;
+			std::string site; // signature of the conversion, which names the target type
+		};
+
+		class istream_base
+		{
+		public:
+			istream_base()
+				: pos(0)
+				, line_ptr(str.data())
+				, line_len(0)
+				, line_in_str(true)
+				, read_ptr(str.data())
+				, read_len(0)
+				, delimiter(",")
+				, unescape_str("##")
+				, trim_quote_on_str(false)
+				, trim_quote('\"')
+				, trim_quote_str(1, trim_quote)
+				, terminate_on_blank_line(true)
+				, quote_unescape("&quot;")
+				, newline_unescape("&newline;")
+				, line_num(0)
+				, token_num(0)
+				, allow_blank_line(false)
+				, field_offsets_enabled(false)
+				, line_plain(false)
+				, line_has_cr(true)
+				, line_has_escape(true)
+				, fixed_tokenizer(NULL)
+				, errors_collected(false)
+				, max_errors(1000)
+				, error_total(0)
+				, bad_lines(0)
+				, line_error(false)
+				, quarantine(NULL)
+				, utf8_validated(false)
+				, utf8_error_total(0)
+				, line_utf8_invalid(false)
+			{
+			}
+			void set_newline_unescape(std::string const& newline_unescape_)
+			{
+				newline_unescape = newline_unescape_;
+			}
+			std::string const& get_newline_unescape() const
+			{
+				return newline_unescape;
+			}
+			// eof is replaced by read_line
+			//bool eof() const
+			void set_delimiter(char delimiter_, std::string const& unescape_str_)
+			{
+				delimiter = delimiter_;
+				unescape_str = unescape_str_;
+			}
+			// Delimiter of several characters, e.g. "||"
+			void set_delimiter(std::string const& delimiter_, std::string const& unescape_str_)
+			{
+				delimiter = delimiter_.empty() ? std::string(1, ',') : delimiter_;
+				unescape_str = unescape_str_;
+			}
+			std::string const& get_delimiter() const
+			{
+				return delimiter;
+			}
+			const std::string& get_delimited_str()
+			{
+				if (fixed_tokenizer)
+					return fixed_tokenizer(*this);
+
+				return tokenize(runtime_dialect(delimiter, trim_quote));
+			}
+			// When enabled, read_line finds the offsets of all the fields in one pass,
+			// so that field(k) can be read in any order and field_count() is free.
+			void enable_field_offsets(bool enable)
+			{
+				field_offsets_enabled = enable;
+			}
+			size_t field_count() const
+			{
+				return field_spans.size();
+			}
+			// Raw field text in the current line, quotes and escapes included
+			field_view raw_field(size_t k) const
+			{
+				if (k >= field_spans.size())
+					throw std::out_of_range("csv::istream_base field index out of range");
+
+				return field_view(line_ptr + field_spans[k].begin, field_spans[k].end - field_spans[k].begin);
+			}
+			// Unquoted and unescaped field, the same text get_delimited_str() would return
+			const std::string& field(size_t k)
+			{
+				if (k >= field_spans.size())
+					throw std::out_of_range("csv::istream_base field index out of range");
+
+				const runtime_dialect d(delimiter, trim_quote);
+				token.clear();
+				decode_field(field_spans[k].begin, field_spans[k].end, field_spans[k].quoted, token, d);
+				token_num = k + 1;
+				unescape(token, d);
+				return token;
+			}
+			void enable_trim_quote_on_str(bool enable, char quote, const std::string& unescape = "&quot;")
+			{
+				trim_quote_on_str = enable;
+				trim_quote = quote;
+				trim_quote_str = std::string(1, trim_quote);
+				quote_unescape = unescape;
+			}
+			std::string get_rest_of_line() const
+			{
+				return (pos < line_len) ? std::string(line_ptr + pos, line_len - pos) : std::string();
+			}
+			void enable_blank_line(bool enable)
+			{
+				allow_blank_line = enable;
+			}
+			std::string const& get_unescape_str() const
+			{
+				return unescape_str;
+			}
+			size_t num_of_delimiter() const
+			{
+				if (delimiter.size() == 0)
+					return 0;
+
+				if (!field_spans.empty())
+					return field_spans.size() - 1;
+
+				const runtime_dialect d(delimiter, trim_quote);
+				size_t cnt = 0;
+				//if (trim_quote_on_str)
+				{
+					bool inside_quote = false;
+					for (size_t i = 0; i < line_len; ++i)
+					{
+						if (line_ptr[i] == trim_quote)
+							inside_quote = !inside_quote;
+
+						if (!inside_quote)
+						{
+							if (at_delimiter(i, d))
+							{
+								++cnt;
+								i += d.delimiter_size() - 1;
+							}
+						}
+					}
+				}
+				return cnt;
+			}
+			// The line may be a view into the caller's buffer, in which case it is copied on first request
+			const std::string& get_line() const
+			{
+				if (!line_in_str)
+				{
+					// past the last field, where str still holds the line read for the quarantine
+					if (line_len == 0)
+					{
+						static const std::string none;
+						return none;
+					}
+					str.assign(line_ptr, line_len);
+					line_in_str = true;
+				}
+				return str;
+			}
+			void enable_terminate_on_blank_line(bool enable)
+			{
+				terminate_on_blank_line = enable;
+			}
+			bool is_terminate_on_blank_line() const
+			{
+				return terminate_on_blank_line;
+			}
+			// Hash of the settings which change how lines are split and unescaped
+			uint64_t settings_hash() const
+			{
+				const char flags[4] = { trim_quote, static_cast<char>(trim_quote_on_str),
+					static_cast<char>(terminate_on_blank_line), static_cast<char>(allow_blank_line) };
+				uint64_t hash = fnv1a(flags, sizeof(flags));
+				const std::string* texts[] = { &delimiter, &unescape_str, &quote_unescape, &newline_unescape };
+				for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i)
+				{
+					hash = fnv1a(texts[i]->data(), texts[i]->size(), hash);
+					hash = fnv1a("\0", 1, hash);
+				}
+				return hash;
+			}
+			// Guess the delimiter, column count and types from a sample of the input.
+			// Quotes and escapes are looked for with the current quote and unescape settings.
+			dialect_info sniff_text(const char* data, size_t size) const
+			{
+				dialect_info info;
+				info.quote = trim_quote;
+
+				// drop the last line if the sample cut it short
+				size_t sample_len = size;
+				if (sample_len > 0 && data[sample_len - 1] != NEWLINE)
+				{
+					const char* last_nl = NULL;
+					for (size_t i = sample_len; i > 0; --i)
+					{
+						if (data[i - 1] == NEWLINE)
+						{
+							last_nl = data + i - 1;
+							break;
+						}
+					}
+					if (last_nl)
+						sample_len = static_cast<size_t>(last_nl - data) + 1;
+				}
+
+				std::vector<field_view> lines;
+				for (size_t i = 0; i < sample_len;)
+				{
+					const char* nl = static_cast<const char*>(memchr(data + i, NEWLINE, sample_len - i));
+					size_t len = nl ? static_cast<size_t>(nl - (data + i)) : sample_len - i;
+					size_t next = i + len + 1;
+					if (len > 0 && data[i + len - 1] == '\r')
+						--len;
+					if (len > 0)
+						lines.push_back(field_view(data + i, len));
+					i = next;
+				}
+				if (lines.empty())
+					return info;
+
+				info.has_quotes = memchr(data, trim_quote, sample_len) != NULL;
+				info.has_escapes = find_bytes(data, sample_len, unescape_str.data(), unescape_str.size())
+					|| find_bytes(data, sample_len, quote_unescape.data(), quote_unescape.size())
+					|| find_bytes(data, sample_len, newline_unescape.data(), newline_unescape.size());
+
+				// the delimiter is the candidate with the most consistent non-zero count per line
+				const char candidates[] = { ',', ';', '\t', '|', ':' };
+				size_t best_lines = 0;
+				size_t best_count = 0;
+				for (size_t c = 0; c < sizeof(candidates); ++c)
+				{
+					std::vector<size_t> counts;
+					for (size_t l = 0; l < lines.size(); ++l)
+						counts.push_back(count_outside_quotes(lines[l], candidates[c]));
+
+					std::vector<size_t> sorted(counts);
+					std::sort(sorted.begin(), sorted.end());
+					size_t mode = 0, mode_lines = 0;
+					for (size_t i = 0; i < sorted.size();)
+					{
+						size_t j = i;
+						while (j < sorted.size() && sorted[j] == sorted[i])
+							++j;
+						if (sorted[i] > 0 && (j - i > mode_lines || (j - i == mode_lines && sorted[i] > mode)))
+						{
+							mode = sorted[i];
+							mode_lines = j - i;
+						}
+						i = j;
+					}
+					if (mode_lines > best_lines || (mode_lines == best_lines && mode > best_count))
+					{
+						best_lines = mode_lines;
+						best_count = mode;
+						info.delimiter = candidates[c];
+					}
+				}
+				info.column_count = best_count + 1;
+
+				// column types from the rows after the first, which may be a header
+				info.column_types.assign(info.column_count, dialect_info::empty_column);
+				std::vector<dialect_info::column_type> first_row;
+				for (size_t l = 0; l < lines.size(); ++l)
+				{
+					size_t col = 0;
+					const char* p = lines[l].begin();
+					const char* const end = lines[l].end();
+					while (true)
+					{
+						const char* d = static_cast<const char*>(memchr(p, info.delimiter, static_cast<size_t>(end - p)));
+						const char* field_end = d ? d : end;
+						const dialect_info::column_type type = classify_field(field_view(p, static_cast<size_t>(field_end - p)));
+						if (l == 0)
+							first_row.push_back(type);
+						else if (col < info.column_count && type > info.column_types[col])
+							info.column_types[col] = type;
+						++col;
+						if (d == NULL)
+							break;
+						p = d + 1;
+					}
+				}
+				if (lines.size() > 1)
+				{
+					bool all_text = true;
+					bool numbers_below = false;
+					for (size_t col = 0; col < first_row.size() && col < info.column_count; ++col)
+					{
+						if (first_row[col] != dialect_info::text_column)
+							all_text = false;
+						if (info.column_types[col] == dialect_info::integer_column || info.column_types[col] == dialect_info::float_column)
+							numbers_below = true;
+					}
+					info.has_header = all_text && numbers_below;
+				}
+				else
+				{
+					info.column_types = first_row;
+				}
+				return info;
+			}
+			// Apply the sniffed dialect. Escapes not seen in the sample are switched off,
+			// so lines without quotes take the plain path with no unescaping.
+			void set_dialect(const dialect_info& info)
+			{
+				delimiter = info.delimiter;
+				trim_quote = info.quote;
+				trim_quote_str = std::string(1, trim_quote);
+				trim_quote_on_str = info.has_quotes;
+				if (!info.has_escapes)
+				{
+					unescape_str.clear();
+					quote_unescape.clear();
+					newline_unescape.clear();
+				}
+			}
+		protected:
+			void set_line(const char* data, size_t size, bool in_str)
+			{
+				line_ptr = data;
+				line_len = size;
+				line_in_str = in_str;
+				pos = 0;
+				field_spans.clear();
+				line_plain = false;
+				line_has_cr = true;
+				line_has_escape = true;
+			}
+			void clear_line()
+			{
+				str.clear();
+				set_line(str.data(), 0, true);
+				read_ptr = str.data();
+				read_len = 0;
+			}
+			// Called by read_line when a line is accepted
+			void begin_line()
+			{
+				read_ptr = line_ptr;
+				read_len = line_len;
+				++line_num;
+				token_num = 0;
+				line_error = false;
+				line_utf8_invalid = false;
+				if (utf8_validated)
+					validate_utf8();
+
+				// a line without quotes and escapes is split with memchr and needs no unescaping
+				line_plain = memchr(line_ptr, trim_quote, line_len) == NULL;
+				line_has_cr = memchr(line_ptr, '\r', line_len) != NULL;
+				line_has_escape = find_bytes(line_ptr, line_len, unescape_str.data(), unescape_str.size())
+					|| find_bytes(line_ptr, line_len, quote_unescape.data(), quote_unescape.size())
+					|| find_bytes(line_ptr, line_len, newline_unescape.data(), newline_unescape.size());
+
+				if (field_offsets_enabled)
+					build_field_offsets();
+			}
+			void validate_utf8()
+			{
+				size_t p = 0;
+				while (p < line_len)
+				{
+					p += utf8_invalid_at(line_ptr + p, line_len - p);
+					if (p >= line_len)
+						break;
+					line_utf8_invalid = true;
+					++utf8_error_total;
+					if (utf8_errors.size() < max_errors)
+						utf8_errors.push_back(encoding_error(line_num, p + 1));
+					// one error for the bad byte and the continuation bytes after it
+					++p;
+					while (p < line_len && (static_cast<unsigned char>(line_ptr[p]) & 0xC0) == 0x80)
+						++p;
+				}
+			}
+			void end_of_line()
+			{
+				// the offsets table refers to the line, so keep it alive
+				if (field_offsets_enabled)
+					pos = line_len;
+				else // an empty view, which leaves the line as read for the quarantine
+					set_line(line_ptr + line_len, 0, false);
+			}
+			typedef const std::string& (*tokenizer_fn)(istream_base&);
+
+			template<typename D>
+			void fix_dialect()
+			{
+				const D d;
+				delimiter = std::string(1, d.delimiter());
+				trim_quote = d.quote();
+				trim_quote_str = std::string(1, trim_quote);
+				trim_quote_on_str = d.has_quote();
+				if (!d.has_escape())
+				{
+					unescape_str.clear();
+					quote_unescape.clear();
+					newline_unescape.clear();
+				}
+				fixed_tokenizer = &fixed_tokenize<D>;
+			}
+
+			// Tokenizer for the fixed_* streams, specialized on their dialect
+			template<typename D>
+			static const std::string& fixed_tokenize(istream_base& is)
+			{
+				return is.tokenize(D());
+			}
+			template<typename D>
+			const std::string& tokenize(const D& d)
+			{
+				token.clear();
+				if (pos >= line_len)
+				{
+					end_of_line();
+				}
+				else
+				{
+					bool quoted = false;
+					const size_t begin = pos;
+					const size_t end = scan_field(pos, quoted, d);
+					decode_field(begin, end, quoted, token, d);
+					if (pos == end) // no delimiter after the last field
+						end_of_line();
+				}
+
+				++token_num;
+				if (!line_plain || line_has_escape)
+					unescape(token, d);
+				return token;
+			}
+			// Scan the field starting at p, with the same quote rules as get_delimited_str.
+			// Returns the end of the field and moves p past its delimiter, if there is one.
+			// quoted is set when the field contains the quote character.
+			template<typename D>
+			size_t scan_field(size_t& p, bool& quoted, const D& d) const
+			{
+				const char delim = d.delimiter();
+				const char quote = d.quote();
+				bool within_quote = false;
+				quoted = false;
+				if ((line_plain || !d.has_quote()) && !line_has_cr)
+				{
+					// a longer delimiter is found by its first character, then verified
+					const char* found = (d.delimiter_size() == 1)
+						? static_cast<const char*>(memchr(line_ptr + p, delim, line_len - p))
+						: find_bytes(line_ptr + p, line_len - p, d.delimiter_str(), d.delimiter_size());
+					if (found == NULL)
+					{
+						p = line_len;
+						return p;
+					}
+					const size_t end = static_cast<size_t>(found - line_ptr);
+					p = end + d.delimiter_size();
+					return end;
+				}
+				while (p < line_len)
+				{
+					const char ch = line_ptr[p];
+					if (ch != delim && (!d.has_quote() || ch != quote) && ch != '\r' && ch != '\n')
+					{
+						++p;
+						continue;
+					}
+
+					if (d.has_quote())
+					{
+						if (within_quote && ch == quote && p + 1 < line_len && line_ptr[p + 1] == quote)
+						{
+							p += 2;
+							continue;
+						}
+
+						if (within_quote == false && ch == quote && (p == 0 || follows_delimiter(p, d)))
+							within_quote = true;
+						else if (within_quote && ch == quote)
+							within_quote = false;
+
+						if (ch == quote)
+							quoted = true;
+					}
+
+					if (ch == delim && within_quote == false && at_delimiter(p, d))
+					{
+						p += d.delimiter_size();
+						return p - d.delimiter_size();
+					}
+
+					++p;
+
+					if (ch == '\r' || ch == '\n')
+						return p - 1;
+				}
+				return p;
+			}
+			// True when the delimiter starts at line_ptr[i]
+			template<typename D>
+			bool at_delimiter(size_t i, const D& d) const
+			{
+				if (d.delimiter_size() == 1)
+					return line_ptr[i] == d.delimiter();
+
+				return i + d.delimiter_size() <= line_len && memcmp(line_ptr + i, d.delimiter_str(), d.delimiter_size()) == 0;
+			}
+			// True when the delimiter ends right before line_ptr[i]
+			template<typename D>
+			bool follows_delimiter(size_t i, const D& d) const
+			{
+				if (d.delimiter_size() == 1)
+					return line_ptr[i - 1] == d.delimiter();
+
+				return i >= d.delimiter_size() && memcmp(line_ptr + i - d.delimiter_size(), d.delimiter_str(), d.delimiter_size()) == 0;
+			}
+			size_t scan_field(size_t& p, bool& quoted) const
+			{
+				return scan_field(p, quoted, runtime_dialect(delimiter, trim_quote));
+			}
+			// Append the field text in [begin, end) to dst, collapsing doubled quotes within quotes
+			template<typename D>
+			void decode_field(size_t begin, size_t end, bool quoted, std::string& dst, const D& d) const
+			{
+				if (!quoted || !d.has_quote())
+				{
+					dst.append(line_ptr + begin, end - begin);
+					return;
+				}
+
+				const char quote = d.quote();
+				bool within_quote = false;
+				for (size_t i = begin; i < end; ++i)
+				{
+					const char ch = line_ptr[i];
+					if (ch == quote)
+					{
+						if (within_quote && i + 1 < end && line_ptr[i + 1] == quote)
+						{
+							dst += ch;
+							++i;
+							continue;
+						}
+
+						if (within_quote == false && (i == 0 || follows_delimiter(i, d)))
+							within_quote = true;
+						else if (within_quote)
+							within_quote = false;
+					}
+					dst += ch;
+				}
+			}
+			size_t count_outside_quotes(const field_view& line, char ch) const
+			{
+				size_t cnt = 0;
+				bool inside_quote = false;
+				for (size_t i = 0; i < line.size(); ++i)
+				{
+					if (line[i] == trim_quote)
+						inside_quote = !inside_quote;
+					else if (!inside_quote && line[i] == ch)
+						++cnt;
+				}
+				return cnt;
+			}
+			static dialect_info::column_type classify_field(const field_view& field)
+			{
+				if (field.empty())
+					return dialect_info::empty_column;
+
+				size_t i = (field[0] == '-' || field[0] == '+') ? 1 : 0;
+				size_t digits = 0, dots = 0, exps = 0;
+				for (; i < field.size(); ++i)
+				{
+					const char ch = field[i];
+					if (ch >= '0' && ch <= '9')
+						++digits;
+					else if (ch == '.' && exps == 0)
+						++dots;
+					else if ((ch == 'e' || ch == 'E') && digits > 0 && exps == 0 && i + 1 < field.size())
+					{
+						++exps;
+						if (field[i + 1] == '-' || field[i + 1] == '+')
+							++i;
+					}
+					else
+						return dialect_info::text_column;
+				}
+				if (digits == 0 || dots > 1)
+					return dialect_info::text_column;
+
+				return (dots == 0 && exps == 0) ? dialect_info::integer_column : dialect_info::float_column;
+			}
+			void build_field_offsets()
+			{
+				size_t p = 0;
+				while (true)
+				{
+					bool quoted = false;
+					const size_t begin = p;
+					const size_t end = scan_field(p, quoted);
+					field_spans.push_back(field_span(begin, end, quoted));
+					if (p == end)
+						break;
+					if (p >= line_len)
+					{
+						// a delimiter at the end of line is followed by an empty field, a CR is not
+						if (line_ptr[end] != '\r' && line_ptr[end] != '\n')
+							field_spans.push_back(field_span(line_len, line_len, false));
+						break;
+					}
+				}
+			}
+			template<typename D>
+			std::string& unescape(std::string& src, const D& d)
+			{
+				if (d.has_escape() && !unescape_str.empty())
+					replace(src, unescape_str, delimiter);
+
+				//if (trim_quote_on_str)
+				{
+					if (d.has_quote() && !src.empty() && (src[0] == d.quote() && src[src.size() - 1] == d.quote()))
+					{
+						src.erase(src.size() - 1);
+						if (!src.empty())
+							src.erase(0, 1);
+					}
+
+					if (d.has_escape() && !newline_unescape.empty() && std::string::npos != src.find(newline_unescape, 0))
+					{
+						replace(src, newline_unescape, "\n");
+					}
+
+					if (d.has_escape() && !quote_unescape.empty() && std::string::npos != src.find(quote_unescape, 0))
+					{
+						replace(src, quote_unescape, trim_quote_str);
+					}
+				}
+
+				return src;
+			}
+		public:
+			// In error collection mode, conversion errors are recorded instead of thrown:
+			// the value is left as the failed conversion set it and reading goes on. The
+			// first max_errors errors are kept, all of them are counted.
+			void enable_error_collection(bool enable)
+			{
+				errors_collected = enable;
+			}
+			bool is_collecting_errors() const
+			{
+				return errors_collected;
+			}
+			void set_max_errors(size_t max_errors_)
+			{
+				max_errors = max_errors_;
+			}
+			// Lines with a conversion error are also written to out, as they were read
+			void set_quarantine(std::ostream* out)
+			{
+				quarantine = out;
+			}
+			const std::vector<parse_error>& get_errors() const
+			{
+				return errors;
+			}
+			size_t error_count() const
+			{
+				return error_total;
+			}
+			size_t bad_line_count() const
+			{
+				return bad_lines;
+			}
+			// True when a field of the current line failed to convert
+			bool line_has_error() const
+			{
+				return line_error;
+			}
+			void clear_errors()
+			{
+				errors.clear();
+				error_total = 0;
+				bad_lines = 0;
+				line_error = false;
+			}
+			// Throws, or records the error in error collection mode
+			void conversion_error(const std::string& token, const char* site)
+			{
+				if (!errors_collected)
+					throw std::runtime_error(error_line(token, site).c_str());
+
+				++error_total;
+				if (!line_error)
+				{
+					line_error = true;
+					++bad_lines;
+					if (quarantine)
+					{
+						quarantine->write(read_ptr, static_cast<std::streamsize>(read_len));
+						quarantine->put(NEWLINE);
+					}
+				}
+				if (errors.size() < max_errors)
+					errors.push_back(parse_error(line_num, token_num, token, site));
+			}
+			// Check that every line read is valid UTF-8. Invalid sequences are reported by
+			// line and column, the first max_errors of them are kept.
+			void enable_utf8_validation(bool enable)
+			{
+				utf8_validated = enable;
+			}
+			const std::vector<encoding_error>& get_encoding_errors() const
+			{
+				return utf8_errors;
+			}
+			size_t encoding_error_count() const
+			{
+				return utf8_error_total;
+			}
+			// True when the current line is not valid UTF-8
+			bool line_has_invalid_utf8() const
+			{
+				return line_utf8_invalid;
+			}
+			// Number of lines read so far, which a resumed reader can carry on from
+			size_t get_line_num() const
+			{
+				return line_num;
+			}
+			void set_line_num(size_t line_num_)
+			{
+				line_num = line_num_;
+			}
+			std::string error_line(const std::string& token, const std::string& function_site)
+			{
+				std::ostringstream is;
+				is << "csv::istream_base Conversion error at line no.:" << line_num
+					<< ", filename:" << filename << ", token position:" << token_num
+					<< ", token:" << token << ", function:" << function_site;
+
+				return is.str();
+			}
+
+		protected:
+			mutable std::string str;
+			size_t pos;
+			const char* line_ptr;
+			size_t line_len;
+			mutable bool line_in_str;
+			// The line as read_line accepted it, until the next read_line
+			const char* read_ptr;
+			size_t read_len;
+			std::string delimiter;
+			std::string unescape_str;
+			bool trim_quote_on_str;
+			char trim_quote;
+			std::string trim_quote_str;
+			bool terminate_on_blank_line;
+			std::string quote_unescape;
+			std::string newline_unescape;
+			std::string filename;
+			size_t line_num;
+			size_t token_num;
+			std::string token;
+			bool allow_blank_line;
+
+			struct field_span
+			{
+				field_span(size_t begin_, size_t end_, bool quoted_) : begin(begin_), end(end_), quoted(quoted_) {}
+				size_t begin;
+				size_t end;
+				bool quoted;
+			};
+			bool field_offsets_enabled;
+			std::vector<field_span> field_spans;
+			bool line_plain;
+			bool line_has_cr;
+			bool line_has_escape;
+			tokenizer_fn fixed_tokenizer;
+			bool errors_collected;
+			size_t max_errors;
+			size_t error_total;
+			size_t bad_lines;
+			bool line_error;
+			std::ostream* quarantine;
+			std::vector<parse_error> errors;
+			bool utf8_validated;
+			size_t utf8_error_total;
+			bool line_utf8_invalid;
+			std::vector<encoding_error> utf8_errors;
+		};
+
+		// View of the current row of a reader with field offsets enabled. It stays valid
+		// until the reader moves to the next line.
+		class row_view
+		{
+		public:
+			row_view() : is(NULL) {}
+			explicit row_view(istream_base& is_) : is(&is_) {}
+			size_t size() const
+			{
+				return is->field_count();
+			}
+			// Unquoted and unescaped field, overwritten by the next field access
+			const std::string& operator[](size_t k) const
+			{
+				return is->field(k);
+			}
+			field_view raw(size_t k) const
+			{
+				return is->raw_field(k);
+			}
+			const std::string& line() const
+			{
+				return is->get_line();
+			}
+			template<typename T>
+			T as(size_t k) const
+			{
+				const std::string& str = is->field(k);
+				T val = T();
+				std::istringstream iss(str);
+				iss >> val;
+				if (!(bool)iss)
+					is->conversion_error(str, "mini::csv::row_view::as");
+				return val;
+			}
+		private:
+			istream_base* is;
+		};
+		template<>
+		inline std::string row_view::as<std::string>(size_t k) const
+		{
+			return is->field(k);
+		}
+		template<>
+		inline decimal row_view::as<decimal>(size_t k) const
+		{
+			const std::string& str = is->field(k);
+			decimal val;
+			if (!val.parse(str))
+				is->conversion_error(str, "mini::csv::row_view::as");
+			return val;
+		}
+		template<>
+		inline timestamp row_view::as<timestamp>(size_t k) const
+		{
+			const std::string& str = is->field(k);
+			timestamp val;
+			if (!val.parse(str))
+				is->conversion_error(str, "mini::csv::row_view::as");
+			return val;
+		}
+
+		// Input iterator over the rows of a reader. The reader is advanced by the iterator,
+		// so the row_view it yields is only valid until the next increment. A default
+		// constructed iterator is the end.
+		template<typename Reader>
+		class row_iterator
+		{
+		public:
+			typedef std::input_iterator_tag iterator_category;
+			typedef row_view value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef const row_view* pointer;
+			typedef const row_view& reference;
+
+			row_iterator() : reader(NULL) {}
+			explicit row_iterator(Reader& reader_) : reader(&reader_), row(reader_)
+			{
+				reader->enable_field_offsets(true);
+				++*this;
+			}
+			reference operator*() const { return row; }
+			pointer operator->() const { return &row; }
+			row_iterator& operator++()
+			{
+				if (reader && !reader->read_line())
+					reader = NULL;
+				return *this;
+			}
+			row_iterator operator++(int)
+			{
+				row_iterator prev = *this;
+				++*this;
+				return prev;
+			}
+			friend bool operator==(const row_iterator& a, const row_iterator& b) { return a.reader == b.reader; }
+			friend bool operator!=(const row_iterator& a, const row_iterator& b) { return a.reader != b.reader; }
+		private:
+			Reader* reader;
+			row_view row;
+		};
+		// Single pass range of the rows of a reader, see rows_of()
+		template<typename Reader>
+		class row_range
+		{
+		public:
+			row_range() : reader(NULL) {}
+			explicit row_range(Reader& reader_) : reader(&reader_) {}
+			row_iterator<Reader> begin() const { return row_iterator<Reader>(*reader); }
+			row_iterator<Reader> end() const { return row_iterator<Reader>(); }
+		private:
+			Reader* reader;
+		};
+		// for (const csv::row_view& row : csv::rows_of(is)), or std::count_if(r.begin(), r.end(), pred)
+		template<typename Reader>
+		row_range<Reader> rows_of(Reader& reader)
+		{
+			return row_range<Reader>(reader);
+		}
+
+#ifdef MINICSV_HAS_COROUTINES
+		// Minimal lazy generator: the coroutine runs up to each co_yield as the
+		// generator is iterated, so no row is read ahead. It is also a C++20 input range.
+		template<typename T>
+		class generator
+		{
+		public:
+			struct promise_type
+			{
+				const T* current = nullptr;
+				std::exception_ptr error;
+
+				generator get_return_object() { return generator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+				std::suspend_always initial_suspend() noexcept { return {}; }
+				std::suspend_always final_suspend() noexcept { return {}; }
+				std::suspend_always yield_value(const T& value) noexcept
+				{
+					current = std::addressof(value);
+					return {};
+				}
+				void return_void() noexcept {}
+				void unhandled_exception() { error = std::current_exception(); }
+				template<typename U>
+				std::suspend_never await_transform(U&&) = delete;
+			};
+			class iterator
+			{
+			public:
+				using iterator_concept = std::input_iterator_tag;
+				using iterator_category = std::input_iterator_tag;
+				using value_type = T;
+				using difference_type = std::ptrdiff_t;
+				using reference = const T&;
+				using pointer = const T*;
+
+				iterator() = default;
+				explicit iterator(std::coroutine_handle<promise_type> coro_) : coro(coro_) {}
+				reference operator*() const { return *coro.promise().current; }
+				pointer operator->() const { return coro.promise().current; }
+				iterator& operator++()
+				{
+					resume(coro);
+					return *this;
+				}
+				void operator++(int) { ++*this; }
+				friend bool operator==(const iterator& it, std::default_sentinel_t) { return !it.coro || it.coro.done(); }
+			private:
+				std::coroutine_handle<promise_type> coro;
+			};
+
+			generator() = default;
+			generator(generator&& other) noexcept : coro(other.coro) { other.coro = nullptr; }
+			generator& operator=(generator&& other) noexcept
+			{
+				if (this != &other)
+				{
+					if (coro)
+						coro.destroy();
+					coro = other.coro;
+					other.coro = nullptr;
+				}
+				return *this;
+			}
+			generator(const generator&) = delete;
+			generator& operator=(const generator&) = delete;
+			~generator()
+			{
+				if (coro)
+					coro.destroy();
+			}
+			iterator begin()
+			{
+				if (coro)
+					resume(coro);
+				return iterator(coro);
+			}
+			std::default_sentinel_t end() const { return std::default_sentinel; }
+		private:
+			explicit generator(std::coroutine_handle<promise_type> coro_) : coro(coro_) {}
+			static void resume(std::coroutine_handle<promise_type> coro)
+			{
+				coro.resume();
+				if (coro.done() && coro.promise().error)
+					std::rethrow_exception(coro.promise().error);
+			}
+			std::coroutine_handle<promise_type> coro = nullptr;
+		};
+#endif
+
+		class ifstream : public istream_base
+		{
+		public:
+			ifstream(const std::string& file="")
+				: istream_base()
+				, has_bom(false)
+				, first_line_read(false)
+				, follow_enabled(false)
+				, follow_timeout_ms(1000)
+				, read_offset(0)
+				, range_end(UINT64_MAX)
+				, follow_inode(0)
+				, watch_fd(-1)
+				, checksum_enabled(false)
+				, per_record_checksum(false)
+				, last_record_checksum(0)
+				, sink_column(0)
+				, sink_chunk_size(0)
+				, max_line_size(0)
+				, long_lines(0)
+				, line_sunk(false)
+			{
+				open(file);
+			}
+			ifstream(const char * file)
+				: istream_base()
+				, follow_enabled(false)
+				, follow_timeout_ms(1000)
+				, read_offset(0)
+				, range_end(UINT64_MAX)
+				, follow_inode(0)
+				, watch_fd(-1)
+				, checksum_enabled(false)
+				, per_record_checksum(false)
+				, last_record_checksum(0)
+				, sink_column(0)
+				, sink_chunk_size(0)
+				, max_line_size(0)
+				, long_lines(0)
+				, line_sunk(false)
+			{
+				open(file);
+			}
+			~ifstream()
+			{
+				unwatch();
+				detach_transcoder();
+			}
+			void open(const std::string& file)
+			{
+				if (!file.empty())
+					open(file.c_str());
+			}
+			void open(const char * file)
+			{
+				init();
+				filename = file;
+				// binary like the ranged open, so offsets count the bytes of the file
+				istm.open(file, std::ios_base::in | std::ios_base::binary);
+				read_bom();
+			}
+			// Reads the split [begin, end) of the file, for processing a file in parallel
+			// by splits. The split starts at the first line which begins at or after begin,
+			// and ends with the line which straddles end, so adjacent splits neither overlap
+			// nor leave gaps. Lines are found by their newlines without regard to quotes, so
+			// a file with newlines within quoted fields cannot be split. UTF-16 files cannot
+			// be split, as the offsets are those of the UTF-8 text and the transcoder cannot
+			// seek, so the stream is closed for them.
+			void open(const std::string& file, uint64_t begin, uint64_t end)
+			{
+				init();
+				filename = file;
+				istm.open(file.c_str(), std::ios_base::in | std::ios_base::binary);
+				read_bom();
+				if (is_transcoding())
+				{
+					close();
+					return;
+				}
+				range_end = end;
+				if (begin > 0 && istm.is_open())
+				{
+					// the line that ends at begin - 1 belongs to the previous split
+					std::string skipped;
+					istm.seekg(static_cast<std::streamoff>(begin - 1));
+					std::getline(istm, skipped);
+					read_offset = begin + skipped.size();
+					first_line_read = true;
+				}
+			}
+			void read_bom()
+			{
+				char tt[3] = { 0, 0, 0 };
+
+				istm.read(tt, sizeof(tt));
+
+				if (tt[0] == (char)0xEF || tt[1] == (char)0xBB || tt[2] == (char)0xBF) // not the correct BOM, so reset the pos to beginning (file might not have BOM)
+					has_bom = true;
+
+				istm.seekg(0, istm.beg);
+
+				// UTF-16 text is read through a transcoder to UTF-8, after its BOM
+				const bool utf16_le = (tt[0] == (char)0xFF && tt[1] == (char)0xFE);
+				const bool utf16_be = (tt[0] == (char)0xFE && tt[1] == (char)0xFF);
+				if (utf16_le || utf16_be)
+				{
+					has_bom = false;
+					istm.clear();
+					istm.seekg(2, istm.beg);
+					transcoder.attach(istm.rdbuf(), utf16_be);
+					static_cast<std::istream&>(istm).rdbuf(&transcoder);
+				}
+			}
+			// True when the file is UTF-16 and read as UTF-8
+			bool is_transcoding() const
+			{
+				return static_cast<const std::istream&>(istm).rdbuf() == &transcoder;
+			}
+			void init()
+			{
+				clear_line();
+				delimiter = ',';
+				unescape_str = "##";
+				trim_quote_on_str = false;
+				trim_quote = '\"';
+				trim_quote_str = std::string(1, trim_quote);
+				terminate_on_blank_line = true;
+				has_bom = false;
+				first_line_read = false;
+				filename = "";
+				line_num = 0;
+				token_num = 0;
+				allow_blank_line = false;
+				field_offsets_enabled = false;
+				fixed_tokenizer = NULL; // the runtime dialect above applies again
+				detach_transcoder();
+				follow_enabled = false;
+				read_offset = 0;
+				range_end = UINT64_MAX;
+				pending.clear();
+				unwatch();
+				file_checksum.reset();
+				record_checksum.reset();
+				last_record_checksum = 0;
+				long_lines = 0;
+			}
+			void close()
+			{
+				unwatch();
+				detach_transcoder();
+				istm.close();
+			}
+			// Running checksum of the bytes read, including the newlines and a UTF-8 BOM,
+			// for verifying a transfer without a second pass. It starts over on open, and
+			// stays readable after close. UTF-16 files are summed as the UTF-8 they are
+			// transcoded to. With per_record, get_record_checksum() is the checksum of the
+			// last line read, including its newline.
+			void enable_checksum(bool enable, checksum::algorithm algo = checksum::crc32c, bool per_record = false)
+			{
+				checksum_enabled = enable;
+				per_record_checksum = per_record;
+				file_checksum = checksum(algo);
+				record_checksum = checksum(algo);
+				last_record_checksum = 0;
+			}
+			uint64_t get_checksum() const
+			{
+				return file_checksum.digest();
+			}
+			uint64_t get_record_checksum() const
+			{
+				return last_record_checksum;
+			}
+			// Receives a large field in chunks: data and size of the chunk, and last on the final chunk
+			typedef std::function<void(const char* data, size_t size, bool last)> field_sink_fn;
+
+			// Hands field column (0-based) of every line to sink in chunks of about chunk_size
+			// bytes while the line is read, so the field is never held in memory. The field then
+			// reads as empty. The sink gets the bytes as they are in the file, with their quotes
+			// and escapes. Columns are counted with the quote rules of the tokenizer, so a
+			// delimiter within quotes does not start one. Not used in follow mode.
+			void set_field_sink(size_t column, const field_sink_fn& sink, size_t chunk_size = 64 * 1024)
+			{
+				sink_column = column;
+				field_sink = sink;
+				sink_chunk_size = chunk_size > 0 ? chunk_size : 1;
+			}
+			void clear_field_sink()
+			{
+				field_sink = field_sink_fn();
+			}
+			// Lines longer than max_size bytes, not counting a field given to the field sink,
+			// are skipped without being held in memory, and counted by long_line_count(). In
+			// error collection mode they are also reported as conversion errors, and the
+			// quarantine gets a marker line in their place. 0 means no limit. Not used in
+			// follow mode.
+			void set_max_line_size(size_t max_size)
+			{
+				max_line_size = max_size;
+			}
+			size_t get_max_line_size() const
+			{
+				return max_line_size;
+			}
+			// Lines skipped for being longer than the maximum line size since the file was opened
+			size_t long_line_count() const
+			{
+				return long_lines;
+			}
+			// Follow mode for files which are still being appended to, like tail -f.
+			// read_line() waits up to timeout_ms for a complete line before returning false,
+			// and can be called again later to resume. A partially written last line is held
+			// back until its newline arrives. When the file is truncated or rotated, it is
+			// reopened and read from the start. Changes are waited for with inotify on Linux
+			// and by polling elsewhere. Blank lines are skipped unless enable_blank_line is set.
+			void enable_follow(bool enable, int timeout_ms = 1000)
+			{
+				follow_enabled = enable;
+				follow_timeout_ms = timeout_ms;
+				unwatch();
+				if (enable)
+				{
+					uint64_t size = 0;
+					int64_t mtime = 0;
+					file_stat(filename, size, mtime, follow_inode);
+					watch();
+				}
+			}
+			// Byte offset of the next line to read. Together with get_line_num(), it is a
+			// checkpoint from which open(file, offset, end) and set_line_num() resume.
+			uint64_t get_offset() const
+			{
+				return read_offset;
+			}
+			bool is_open()
+			{
+				return istm.is_open();
+			}
+			// Sniff the dialect from the head of the file, without moving the read position
+			dialect_info sniff(size_t sample_size = 64 * 1024)
+			{
+				if (is_transcoding())
+					return sniff_utf16(sample_size);
+
+				const std::streampos cur = istm.tellg();
+				if (!istm.is_open() || cur == std::streampos(-1))
+					return dialect_info();
+
+				std::string sample(sample_size, '\0');
+				istm.read(&sample[0], static_cast<std::streamsize>(sample_size));
+				sample.resize(static_cast<size_t>(istm.gcount()));
+				istm.clear();
+				istm.seekg(cur);
+
+				const size_t skip = (cur == std::streampos(0) && has_bom && sample.size() >= 3) ? 3 : 0;
+				return sniff_text(sample.data() + skip, sample.size() - skip);
+			}
+			void skip_line()
+			{
+				if (!istm.eof())
+				{
+					std::getline(istm, str);
+					read_offset += str.size() + (istm.eof() ? 0 : 1);
+					if (checksum_enabled)
+						checksum_bytes(str.data(), str.size(), !istm.eof(), !str.empty() || !istm.eof());
+					set_line(str.data(), str.size(), true);
+
+					if (first_line_read == false)
+					{
+						first_line_read = true;
+					}
+				}
+			}
+			bool read_line()
+			{
+				if (follow_enabled)
+					return read_followed_line();
+
+				clear_line();
+				while (!istm.eof() && read_offset < range_end)
+				{
+					if (field_sink || max_line_size > 0)
+					{
+						if (!scan_line())
+							continue;
+					}
+					else
+					{
+						line_sunk = false;
+						std::getline(istm, this->str);
+						read_offset += this->str.size() + (istm.eof() ? 0 : 1);
+						if (checksum_enabled)
+							checksum_bytes(this->str.data(), this->str.size(), !istm.eof(), !this->str.empty() || !istm.eof());
+
+						if (first_line_read == false)
+						{
+							first_line_read = true;
+							if (has_bom)
+							{
+								this->str = this->str.substr(3);
+							}
+						}
+					}
+					set_line(this->str.data(), this->str.size(), true);
+
+					if (this->str.empty() && !line_sunk)
+					{
+						if (terminate_on_blank_line)
+							break;
+						else if (allow_blank_line == false)
+							continue;
+					}
+
+					begin_line();
+					return true;
+				}
+				return false;
+			}
+#ifdef MINICSV_HAS_COROUTINES
+			// Lazily reads the rows, for (auto row : is.rows()). Field offsets are enabled.
+			generator<row_view> rows()
+			{
+				enable_field_offsets(true);
+				while (read_line())
+					co_yield row_view(*this);
+			}
+#endif
+
+		private:
+			// Reads a line like std::getline, in chunks found with istream::getline. The field
+			// sink column goes to the field sink instead of the line, and the line stops being
+			// kept once it is longer than max_line_size. Returns false for a line which was too
+			// long: it is counted, and in error collection mode reported as a conversion error
+			// with a marker line in the quarantine instead of the line itself.
+			bool scan_line()
+			{
+				// bytes held back from the sink: a partial delimiter, or a CR before the newline
+				const size_t keep = delimiter.size() > 1 ? delimiter.size() - 1 : 1;
+				const char delimiter_end = delimiter[delimiter.size() - 1];
+				const size_t chunk_size = 64 * 1024;
+				if (scan_chunk.size() < chunk_size)
+					scan_chunk.resize(chunk_size);
+				char* chunk = &scan_chunk[0];
+				this->str.clear();
+				sink_buf.clear();
+				uint64_t consumed = 0;
+				size_t column = 0;
+				// quotes follow the tokenizer: they open at the start of a field, and a
+				// doubled quote within quotes stands for the quote itself
+				const bool quoting = fixed_tokenizer == NULL || trim_quote_on_str;
+				bool in_quote = false;
+				bool field_start = true;
+				bool just_closed = false;
+				std::string tail; // end of the text outside the sink, to find a delimiter in
+				bool sinking = field_sink && sink_column == 0;
+				bool too_long = false;
+				bool newline = false;
+				line_sunk = false;
+
+				if (first_line_read == false)
+				{
+					first_line_read = true;
+					if (has_bom)
+					{
+						istm.read(chunk, 3);
+						const size_t n = static_cast<size_t>(istm.gcount());
+						consumed += n;
+						if (checksum_enabled)
+							checksum_bytes(chunk, n, false, false);
+					}
+				}
+				while (!newline && !istm.eof())
+				{
+					istm.getline(chunk, static_cast<std::streamsize>(chunk_size));
+					size_t n = static_cast<size_t>(istm.gcount());
+					if (istm.fail() && !istm.eof())
+					{
+						istm.clear(); // the chunk is full and the line goes on
+					}
+					else if (!istm.eof())
+					{
+						newline = true;
+						--n;
+					}
+					consumed += n;
+					if (checksum_enabled)
+						checksum_bytes(chunk, n, false, false);
+
+					size_t i = 0;
+					while (i < n)
+					{
+						// copy up to the next character which can end a field or open a quote
+						size_t j = n;
+						if (field_sink)
+						{
+							const char* found = static_cast<const char*>(memchr(chunk + i, delimiter_end, n - i));
+							if (found)
+								j = static_cast<size_t>(found - chunk);
+							if (quoting)
+							{
+								found = static_cast<const char*>(memchr(chunk + i, trim_quote, j - i));
+								if (found)
+									j = static_cast<size_t>(found - chunk);
+							}
+						}
+						if (j > i)
+						{
+							field_start = false;
+							just_closed = false;
+							if (sinking)
+							{
+								sink_buf.append(chunk + i, j - i);
+								flush_sink(keep);
+							}
+							else
+							{
+								if (!too_long)
+									this->str.append(chunk + i, j - i);
+								if (field_sink)
+									keep_tail(tail, chunk + i, j - i);
+							}
+						}
+						if (j == n)
+							break;
+
+						const char ch = chunk[j];
+						i = j + 1;
+						const bool was_field_start = field_start;
+						field_start = false;
+						if (quoting && ch == trim_quote)
+						{
+							if (in_quote)
+							{
+								in_quote = false;
+								just_closed = true;
+							}
+							else if (was_field_start || just_closed)
+							{
+								in_quote = true;
+								just_closed = false;
+							}
+						}
+						else
+						{
+							just_closed = false;
+						}
+
+						if (sinking)
+						{
+							sink_buf += ch;
+							if (!in_quote && ends_with(sink_buf, delimiter))
+							{
+								field_sink(sink_buf.data(), sink_buf.size() - delimiter.size(), true);
+								line_sunk = true;
+								sinking = false;
+								field_start = true;
+								++column;
+								if (!too_long)
+									this->str += delimiter;
+							}
+							else
+							{
+								flush_sink(keep);
+							}
+							continue;
+						}
+						if (!too_long)
+							this->str += ch;
+						keep_tail(tail, &ch, 1);
+						if (!in_quote && ends_with(tail, delimiter))
+						{
+							tail.clear();
+							field_start = true;
+							++column;
+							sinking = field_sink && column == sink_column;
+						}
+					}
+					if (max_line_size > 0 && this->str.size() > max_line_size)
+						too_long = true;
+				}
+				if (newline)
+					++consumed;
+				if (sinking)
+				{
+					size_t n = sink_buf.size();
+					if (n > 0 && sink_buf[n - 1] == '\r')
+					{
+						--n;
+						if (!too_long)
+							this->str += '\r';
+					}
+					field_sink(sink_buf.data(), n, true);
+					line_sunk = true;
+				}
+				read_offset += consumed;
+				if (checksum_enabled)
+					checksum_bytes(chunk, 0, newline, newline || consumed > 0);
+
+				if (too_long)
+				{
+					++line_num;
+					++long_lines;
+					token_num = 0;
+					line_error = false;
+					if (errors_collected)
+					{
+						std::ostringstream marker;
+						marker << "# line " << line_num << " skipped: longer than " << max_line_size << " bytes";
+						this->str = marker.str();
+						set_line(this->str.data(), this->str.size(), true);
+						read_ptr = line_ptr;
+						read_len = line_len;
+						conversion_error(std::string(), "mini::csv::ifstream::read_line: line longer than the maximum line size");
+					}
+					clear_line();
+					return false;
+				}
+				return true;
+			}
+			// Keeps the last delimiter.size() bytes of the text outside the sink
+			void keep_tail(std::string& tail, const char* p, size_t n) const
+			{
+				const size_t size = delimiter.size();
+				if (n >= size)
+				{
+					tail.assign(p + n - size, size);
+					return;
+				}
+				tail.append(p, n);
+				if (tail.size() > size)
+					tail.erase(0, tail.size() - size);
+			}
+			// Hands the sink whole chunks, holding back the last keep bytes
+			void flush_sink(size_t keep)
+			{
+				size_t done = 0;
+				while (sink_buf.size() - done >= sink_chunk_size + keep)
+				{
+					field_sink(sink_buf.data() + done, sink_chunk_size, false);
+					done += sink_chunk_size;
+				}
+				if (done > 0)
+					sink_buf.erase(0, done);
+			}
+			static bool ends_with(const std::string& text, const std::string& suffix)
+			{
+				return text.size() >= suffix.size() && !suffix.empty()
+					&& memcmp(text.data() + text.size() - suffix.size(), suffix.data(), suffix.size()) == 0;
+			}
+			bool read_followed_line()
+			{
+				clear_line();
+				const std::chrono::steady_clock::time_point deadline =
+					std::chrono::steady_clock::now() + std::chrono::milliseconds(follow_timeout_ms);
+				std::string chunk;
+				while (istm.is_open())
+				{
+					std::getline(istm, chunk);
+					if (checksum_enabled)
+						checksum_bytes(chunk.data(), chunk.size(), !istm.eof(), !istm.eof());
+					if (!istm.eof())
+					{
+						// a complete line, possibly continuing a partial one
+						read_offset += pending.size() + chunk.size() + 1;
+						this->str.swap(pending);
+						this->str += chunk;
+						pending.clear();
+						if (first_line_read == false)
+						{
+							first_line_read = true;
+							if (has_bom && this->str.size() >= 3)
+								this->str.erase(0, 3);
+						}
+						if (this->str.empty() && allow_blank_line == false)
+							continue;
+						set_line(this->str.data(), this->str.size(), true);
+						begin_line();
+						return true;
+					}
+
+					// end of the data written so far
+					pending += chunk;
+					istm.clear();
+					uint64_t size = 0, inode = 0;
+					int64_t mtime = 0;
+					if (file_stat(filename, size, mtime, inode) && (inode != follow_inode || size < read_offset + pending.size()))
+					{
+						// truncated or rotated: the old file is read to its end, start over
+						detach_transcoder();
+						istm.close();
+						istm.clear();
+						istm.open(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+						read_bom();
+						first_line_read = false;
+						read_offset = 0;
+						follow_inode = inode;
+						pending.clear();
+						record_checksum.reset();
+						unwatch();
+						watch();
+						continue;
+					}
+					const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+					if (now >= deadline)
+						return false;
+					wait_for_change(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count());
+				}
+				return false;
+			}
+			// Returns after a change to the file or the timeout. The wait is cut to
+			// 250ms so that a file created in place of a rotated one is noticed.
+			void wait_for_change(long long timeout_ms)
+			{
+				const int slice = static_cast<int>(std::min<long long>(timeout_ms, 250));
+#ifdef MINICSV_HAS_INOTIFY
+				if (watch_fd >= 0)
+				{
+					pollfd pfd;
+					pfd.fd = watch_fd;
+					pfd.events = POLLIN;
+					pfd.revents = 0;
+					if (poll(&pfd, 1, slice) > 0)
+					{
+						char events[4096];
+						while (::read(watch_fd, events, sizeof(events)) > 0) {}
+					}
+					return;
+				}
+#endif
+				std::this_thread::sleep_for(std::chrono::milliseconds(std::min(slice, 50)));
+			}
+			void watch()
+			{
+#ifdef MINICSV_HAS_INOTIFY
+				if (filename.empty())
+					return;
+				watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+				if (watch_fd >= 0 && inotify_add_watch(watch_fd, filename.c_str(), IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF) < 0)
+					unwatch();
+#endif
+			}
+			// Adds a line to the checksums. record_end finishes the record checksum.
+			void checksum_bytes(const char* p, size_t n, bool newline, bool record_end)
+			{
+				file_checksum.update(p, n);
+				if (newline)
+					file_checksum.update("\n", 1);
+				if (!per_record_checksum)
+					return;
+				record_checksum.update(p, n);
+				if (newline)
+					record_checksum.update("\n", 1);
+				if (record_end)
+				{
+					last_record_checksum = record_checksum.digest();
+					record_checksum.reset();
+				}
+			}
+			// The transcoder cannot seek, so the sample is read and transcoded from a
+			// second handle on the file, starting after the BOM.
+			dialect_info sniff_utf16(size_t sample_size) const
+			{
+				std::ifstream raw(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+				char bom[2] = { 0, 0 };
+				raw.read(bom, sizeof(bom));
+				if (raw.gcount() != 2)
+					return dialect_info();
+
+				std::string units(sample_size, '\0');
+				raw.read(&units[0], static_cast<std::streamsize>(sample_size));
+				std::string sample;
+				utf16_to_utf8(units.data(), static_cast<size_t>(raw.gcount()), bom[0] == (char)0xFE, sample);
+				return sniff_text(sample.data(), std::min(sample_size, sample.size()));
+			}
+			void detach_transcoder()
+			{
+				if (is_transcoding())
+					static_cast<std::istream&>(istm).rdbuf(istm.rdbuf());
+			}
+			void unwatch()
+			{
+#ifdef MINICSV_HAS_POSIX
+				if (watch_fd >= 0)
+					::close(watch_fd);
+#endif
+				watch_fd = -1;
+			}
+
+			std::ifstream istm;
+			bool has_bom;
+			bool first_line_read;
+			std::string filename;
+			bool follow_enabled;
+			int follow_timeout_ms;
+			uint64_t read_offset;
+			uint64_t range_end;
+			uint64_t follow_inode;
+			std::string pending;
+			int watch_fd;
+			utf16_transcoder transcoder;
+			bool checksum_enabled;
+			bool per_record_checksum;
+			checksum file_checksum;
+			checksum record_checksum;
+			uint64_t last_record_checksum;
+			field_sink_fn field_sink;
+			size_t sink_column;
+			size_t sink_chunk_size;
+			size_t max_line_size;
+			size_t long_lines;
+			bool line_sunk; // the line had a field given to the field sink
+			std::string sink_buf;
+			std::string scan_chunk;
+		};
+		// C++11 stand-in for std::index_sequence, used to expand tuples in write_row
+		template<size_t... I> struct index_seq {};
+		template<size_t N, size_t... I> struct make_index_seq : make_index_seq<N - 1, N - 1, I...> {};
+		template<size_t... I> struct make_index_seq<0, I...> { typedef index_seq<I...> type; };
+
+		class ostream_base
+		{
+		public:
+			ostream_base()
+				: after_newline(true)
+				, delimiter(",")
+				, escape_str("##")
+				, surround_quote_on_str(false)
+				, surround_quote('\"')
+				, quote_escape("&quot;")
+				, newline_escape("&newline;")
+				, precision(0)
+				, fixed_escaper(NULL)
+			{
+			}
+		public:
+			void enable_surround_quote_on_str(bool enable, char quote, const std::string& escape = "&quot;")
+			{
+				surround_quote_on_str = enable;
+				surround_quote = quote;
+				quote_escape = escape;
+			}
+			void set_newline_escape(std::string const& newline_escape_)
+			{
+				newline_escape = newline_escape_;
+			}
+			std::string const& get_newline_escape() const
+			{
+				return newline_escape;
+			}
+			void set_delimiter(char delimiter_, std::string const& escape_str_)
+			{
+				delimiter = delimiter_;
+				escape_str = escape_str_;
+			}
+			// Delimiter of several characters, e.g. "||"
+			void set_delimiter(std::string const& delimiter_, std::string const& escape_str_)
+			{
+				delimiter = delimiter_.empty() ? std::string(1, ',') : delimiter_;
+				escape_str = escape_str_;
+			}
+			std::string const& get_delimiter() const
+			{
+				return delimiter;
+			}
+			void set_after_newline(bool after_newline_)
+			{
+				after_newline = after_newline_;
+			}
+			bool get_after_newline() const
+			{
+				return after_newline;
+			}
+			// Copy the delimiter, quote, escape and precision settings of another output stream
+			void set_format(const ostream_base& other)
+			{
+				delimiter = other.delimiter;
+				escape_str = other.escape_str;
+				surround_quote_on_str = other.surround_quote_on_str;
+				surround_quote = other.surround_quote;
+				quote_escape = other.quote_escape;
+				newline_escape = other.newline_escape;
+				precision = other.precision;
+				fixed_escaper = other.fixed_escaper;
+			}
+			void set_precision(int precision_)
+			{
+				precision = precision_;
+			}
+			int get_precision()
+			{
+				return precision;
+			}
+			void reset_precision()
+			{
+				precision = 0;
+			}
+		protected:
+			std::string const& get_escape_str() const
+			{
+				return escape_str;
+			}
+			// Escape the text field in place, returns true if it has to be surrounded with quotes
+			bool escape_str_in_place(std::string& src) const
+			{
+				if (fixed_escaper)
+					return fixed_escaper(*this, src);
+
+				return escape_str_in_place(src, runtime_dialect(delimiter, surround_quote));
+			}
+			template<typename D>
+			bool escape_str_in_place(std::string& src, const D& d) const
+			{
+				if (d.has_escape())
+				{
+					if (!escape_str.empty())
+					{
+						replace(src, delimiter, escape_str);
+					}
+					if (!newline_escape.empty())
+					{
+						replace(src, std::string(1, '\n'), newline_escape);
+					}
+					if (surround_quote_on_str || src.find(delimiter) != std::string::npos)
+					{
+						if (!quote_escape.empty())
+						{
+							replace(src, std::string(1, surround_quote), quote_escape);
+						}
+						return true;
+					}
+					return false;
+				}
+
+				// no escape strings: quote the field and double the quotes in it
+				if (!d.has_quote())
+					return false;
+
+				if (surround_quote_on_str || src.find(d.delimiter()) != std::string::npos
+					|| src.find(d.quote()) != std::string::npos)
+				{
+					replace(src, std::string(1, d.quote()), std::string(2, d.quote()));
+					return true;
+				}
+				return false;
+			}
+			typedef bool (*escaper_fn)(const ostream_base&, std::string&);
+
+			// Escaper for the fixed_* streams, specialized on their dialect
+			template<typename D>
+			static bool fixed_escape(const ostream_base& os, std::string& src)
+			{
+				return os.escape_str_in_place(src, D());
+			}
+			template<typename D>
+			void fix_dialect()
+			{
+				const D d;
+				delimiter = std::string(1, d.delimiter());
+				surround_quote = d.quote();
+				if (!d.has_escape())
+				{
+					escape_str.clear();
+					quote_escape.clear();
+					newline_escape.clear();
+				}
+				fixed_escaper = &fixed_escape<D>;
+			}
+			// Escape the delimiter in the non-text field which starts at buf[start]
+			void escape_tail(std::string& buf, size_t start) const
+			{
+				if (escape_str.empty() || buf.find(delimiter, start) == std::string::npos)
+					return;
+
+				std::string tail = buf.substr(start);
+				buf.erase(start);
+				buf += replace(tail, delimiter, escape_str);
+			}
+
+			// format_field overloads append one field to buf with the same formatting
+			// and escaping as the matching operator <<, selected at compile time.
+			void format_field(std::string& buf, const std::string& val)
+			{
+				if (!fixed_escaper && !surround_quote_on_str && val.find(delimiter) == std::string::npos
+					&& val.find('\n') == std::string::npos)
+				{
+					buf += val;
+					return;
+				}
+				field_buf = val;
+				if (escape_str_in_place(field_buf))
+				{
+					buf += surround_quote;
+					buf += field_buf;
+					buf += surround_quote;
+				}
+				else
+				{
+					buf += field_buf;
+				}
+			}
+			void format_field(std::string& buf, const char* val)
+			{
+				format_field(buf, std::string(val));
+			}
+			void format_field(std::string& buf, char* val)
+			{
+				format_field(buf, std::string(val));
+			}
+			void format_field(std::string& buf, char val)
+			{
+				format_field(buf, std::string(1, val));
+			}
+			void format_field(std::string& buf, bool val)
+			{
+				buf += val ? '1' : '0';
+			}
+			void format_field(std::string& buf, const NChar& val)
+			{
+				const size_t start = buf.size();
+				append_integer(buf, static_cast<int>(val.getChar()));
+				escape_tail(buf, start);
+			}
+			void format_field(std::string& buf, float val)
+			{
+				append_floating(buf, static_cast<double>(val));
+			}
+			void format_field(std::string& buf, double val)
+			{
+				append_floating(buf, val);
+			}
+			void format_field(std::string& buf, long double val)
+			{
+				append_floating(buf, val);
+			}
+			template<typename T>
+			void format_field(std::string& buf, const T& val)
+			{
+				const size_t start = buf.size();
+				format_value(buf, val, std::integral_constant<bool, std::is_integral<T>::value
+					&& !std::is_same<T, signed char>::value && !std::is_same<T, unsigned char>::value
+					&& !std::is_same<T, wchar_t>::value>());
+				escape_tail(buf, start);
+			}
+
+			void format_fields(std::string&)
+			{
+			}
+			template<typename T>
+			void format_fields(std::string& buf, const T& last)
+			{
+				format_field(buf, last);
+			}
+			template<typename T, typename... Ts>
+			void format_fields(std::string& buf, const T& first, const Ts&... rest)
+			{
+				format_field(buf, first);
+				buf += delimiter;
+				format_fields(buf, rest...);
+			}
+			template<typename Tuple, size_t... I>
+			void format_tuple(std::string& buf, const Tuple& fields, index_seq<I...>)
+			{
+				format_fields(buf, std::get<I>(fields)...);
+			}
+			// Format a whole row into buf, continuing a partially written row if there is one
+			template<typename... Ts>
+			void format_row(std::string& buf, const Ts&... fields)
+			{
+				if (!after_newline && sizeof...(Ts) > 0)
+					buf += delimiter;
+				format_fields(buf, fields...);
+				buf += NEWLINE;
+				after_newline = true;
+			}
+		private:
+			template<typename T>
+			static void append_integer(std::string& buf, T val)
+			{
+				typedef typename std::make_unsigned<T>::type U;
+				char tmp[24];
+				char* const end = tmp + sizeof(tmp);
+				char* p = end;
+				const bool negative = !(val > 0 || val == 0);
+				U u = negative ? static_cast<U>(U(0) - static_cast<U>(val)) : static_cast<U>(val);
+				do
+				{
+					*--p = static_cast<char>('0' + u % 10);
+					u /= 10;
+				} while (u != 0);
+				if (negative)
+					*--p = '-';
+				buf.append(p, end - p);
+			}
+			template<typename T>
+			void format_value(std::string& buf, const T& val, std::true_type)
+			{
+				append_integer(buf, val);
+			}
+			template<typename T>
+			void format_value(std::string& buf, const T& val, std::false_type)
+			{
+				std::ostringstream os_temp;
+				os_temp << val;
+				buf += os_temp.str();
+			}
+			// Same output as std::ostream, which formats with %g or with %f when set_precision is called
+			template<typename T>
+			void append_floating(std::string& buf, T val)
+			{
+				const size_t start = buf.size();
+				char tmp[64];
+				const bool is_long = (sizeof(T) > sizeof(double));
+				int n = 0;
+				if (precision > 0)
+					n = is_long ? snprintf(tmp, sizeof(tmp), "%.*Lf", precision, static_cast<long double>(val))
+						: snprintf(tmp, sizeof(tmp), "%.*f", precision, static_cast<double>(val));
+				else
+					n = is_long ? snprintf(tmp, sizeof(tmp), "%Lg", static_cast<long double>(val))
+						: snprintf(tmp, sizeof(tmp), "%g", static_cast<double>(val));
+
+				if (n > 0 && static_cast<size_t>(n) < sizeof(tmp))
+				{
+					buf.append(tmp, static_cast<size_t>(n));
+				}
+				else
+				{
+					std::ostringstream os_temp;
+					if (precision > 0)
+						os_temp << std::fixed << std::showpoint << std::setprecision(precision);
+					os_temp << val;
+					buf += os_temp.str();
+				}
+				escape_tail(buf, start);
+			}
+		protected:
+			bool after_newline;
+			std::string delimiter;
+			std::string escape_str;
+			bool surround_quote_on_str;
+			char surround_quote;
+			std::string quote_escape;
+			std::string newline_escape;
+			int precision;
+			std::string field_buf;
+			escaper_fn fixed_escaper;
+		};
+		class ofstream : public ostream_base
+		{
+		public:
+
+			ofstream(const std::string& file = "")
+				: ostream_base()
+				, checksum_enabled(false)
+				, checksum_algo(checksum::crc32c)
+				, per_record_checksum(false)
+			{
+				open(file);
+			}
+			ofstream(const char * file)
+				: ostream_base()
+				, checksum_enabled(false)
+				, checksum_algo(checksum::crc32c)
+				, per_record_checksum(false)
+			{
+				open(file);
+			}
+			~ofstream()
+			{
+				detach_checksum();
+			}
+			void open(const std::string& file)
+			{
+				if (!file.empty())
+					open(file.c_str());
+			}
+			void open(const char * file)
+			{
+				init();
+				detach_checksum();
+				ostm.open(file, std::ios_base::out);
+				if (checksum_enabled)
+					attach_checksum();
+			}
+			void init()
+			{
+				after_newline = true;
+				delimiter = ',';
+				escape_str = "##";
+				surround_quote_on_str = false;
+				surround_quote = '\"';
+				quote_escape = "&quot;";
+				precision = 0;
+			}
+			void flush()
+			{
+				ostm.flush();
+			}
+			void close()
+			{
+				detach_checksum();
+				ostm.close();
+			}
+			// Running checksum of the bytes written, for verifying a transfer without a second
+			// pass. It starts over on open, and stays readable after close. With per_record,
+			// get_record_checksum() is the checksum of the last row ended by a newline.
+			void enable_checksum(bool enable, checksum::algorithm algo = checksum::crc32c, bool per_record = false)
+			{
+				detach_checksum();
+				checksum_enabled = enable;
+				checksum_algo = algo;
+				per_record_checksum = per_record;
+				if (enable)
+					attach_checksum();
+			}
+			uint64_t get_checksum()
+			{
+				summer.drain();
+				return summer.digest();
+			}
+			uint64_t get_record_checksum()
+			{
+				summer.drain();
+				return summer.record_digest();
+			}
+			bool is_open()
+			{
+				return ostm.is_open();
+			}
+			std::ofstream& get_ofstream()
+			{
+				return ostm;
+			}
+			void escape_and_output(std::string src)
+			{
+				ostm << ((escape_str.empty()) ? src : replace(src, delimiter, escape_str));
+			}
+			void escape_str_and_output(std::string src)
+			{
+				if (escape_str_in_place(src))
+				{
+					ostm << surround_quote << src << surround_quote;
+				}
+				else
+				{
+					ostm << src;
+				}
+			}
+			// Format all the fields of a row into one buffer and write it with a single call
+			template<typename... Ts>
+			void write_row(const Ts&... fields)
+			{
+				row_buf.clear();
+				format_row(row_buf, fields...);
+				ostm.write(row_buf.data(), row_buf.size());
+			}
+			template<typename... Ts>
+			void write_row(const std::tuple<Ts...>& fields)
+			{
+				row_buf.clear();
+				if (!after_newline && sizeof...(Ts) > 0)
+					row_buf += delimiter;
+				format_tuple(row_buf, fields, typename make_index_seq<sizeof...(Ts)>::type());
+				row_buf += NEWLINE;
+				after_newline = true;
+				ostm.write(row_buf.data(), row_buf.size());
+			}
+		private:
+			bool is_checksumming() const
+			{
+				return static_cast<const std::ostream&>(ostm).rdbuf() == &summer;
+			}
+			void attach_checksum()
+			{
+				summer.attach(ostm.rdbuf(), checksum_algo, per_record_checksum);
+				static_cast<std::ostream&>(ostm).rdbuf(&summer);
+			}
+			void detach_checksum()
+			{
+				if (is_checksumming())
+				{
+					summer.drain();
+					static_cast<std::ostream&>(ostm).rdbuf(ostm.rdbuf());
+				}
+			}
+
+			std::ofstream ostm;
+			std::string row_buf;
+			bool checksum_enabled;
+			checksum::algorithm checksum_algo;
+			bool per_record_checksum;
+			checksum_buf summer;
+		};
+
+
+	} // ns csv
+} // ns mini
+
+template<typename T>
+mini::csv::ifstream& operator >> (mini::csv::ifstream& istm, T& val)
+{
+	const std::string& str = istm.get_delimited_str();
+
+#ifdef USE_BOOST_LEXICAL_CAST
+	try 
+	{
+		val = boost::lexical_cast<T>(str);
+	}
+	catch (boost::bad_lexical_cast& e)
+	{
+		istm.conversion_error(str, MY_FUNC_SIG);
+		return istm;
+	}
+#else
+	std::istringstream is(str);
+	is >> val;
+	if (!(bool)is)
+	{
+		istm.conversion_error(str, MY_FUNC_SIG);
+		return istm;
+	}
+#endif
+
+	return istm;
+}
+template<>
+inline mini::csv::ifstream& operator >> (mini::csv::ifstream& istm, std::string& val)
+{
+	val = istm.get_delimited_str();
+
+	return istm;
+}
+
+template<>
+inline mini::csv::ifstream& operator >> (mini::csv::ifstream& istm, mini::csv::sep& val)
+{
+	istm.set_delimiter(val.get_delimiter_str(), val.get_escape());
+
+	return istm;
+}
+
+inline mini::csv::ifstream& operator >> (mini::csv::ifstream& istm, mini::csv::NChar val)
+{
+	const std::string& str = istm.get_delimited_str();
+
+	int n = 0;
+#ifdef USE_BOOST_LEXICAL_CAST
+	try
+	{
+		n = boost::lexical_cast<int>(str);
+	}
+	catch (boost::bad_lexical_cast& e)
+	{
+		istm.conversion_error(str, MY_FUNC_SIG);
+		return istm;
+	}
+#else
+	std::istringstream is(str);
+	is >> n;
+	if (!(bool)is)
+	{
+		istm.conversion_error(str, MY_FUNC_SIG);
+		return istm;
+	}
+#endif
+
+	if (n > 127 || n < -128)
+	{
+		istm.conversion_error(str, MY_FUNC_SIG);
+		return istm;
+	}
+
+	char temp = static_cast<char>(n);
+	val.setChar(temp);
+
+	return istm;
+}
+
+inline mini::csv::ifstream& operator >> (mini::csv::ifstream& istm, mini::csv::timestamp& val)
+{
+	const std::string& str = istm.get_delimited_str();
+
+	if (!val.parse(str))
+	{
+		istm.conversion_error(str, MY_FUNC_SIG);
+		return istm;
+	}
+
+	return istm;
+}
+
+inline mini::csv::ifstream& operator >> (mini::csv::ifstream& istm, mini::csv::decimal& val)
+{
+	const std::string& str = istm.get_delimited_str();
+
+	if (!val.parse(str))
+	{
+		istm.conversion_error(str, MY_FUNC_SIG);
+		return istm;
+	}
+
+	return istm;
+}
+
+template<>
+inline mini::csv::ifstream& operator >> (mini::csv::ifstream& istm, char& val)
+{
+	const std::string& src = istm.get_delimited_str();
+
+	if (src.empty())
+	{
+		istm.conversion_error(src, MY_FUNC_SIG);
+		return istm;
+	}
+
+	val = src[0];
+
+	return istm;
+}
+
+template<typename T>
+mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const T& val)
+{
+	if(!ostm.get_after_newline())
+		ostm.get_ofstream() << ostm.get_delimiter();
+
+	std::ostringstream os_temp;
+
+	os_temp << val;
+
+	ostm.escape_and_output(os_temp.str());
+
+	ostm.set_after_newline(false);
+
+	return ostm;
+}
+
+template<typename T>
+mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const T* val)
+{
+	if (!ostm.get_after_newline())
+		ostm.get_ofstream() << ostm.get_delimiter();
+
+	std::ostringstream os_temp;
+
+	os_temp << *val;
+
+	ostm.escape_and_output(os_temp.str());
+
+	ostm.set_after_newline(false);
+
+	return ostm;
+}
+
+template<>
+inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const std::string& val)
+{
+	if (!ostm.get_after_newline())
+		ostm.get_ofstream() << ostm.get_delimiter();
+
+	std::string temp = val;
+	ostm.escape_str_and_output(temp);
+
+	ostm.set_after_newline(false);
+
+	return ostm;
+}
+
+template<>
+inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const mini::csv::sep& val)
+{
+	ostm.set_delimiter(val.get_delimiter_str(), val.get_escape());
+
+	return ostm;
+}
+
+template<>
+inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const char& val)
+{
+	if(val==NEWLINE)
+	{
+		ostm.get_ofstream() << NEWLINE;
+
+		ostm.set_after_newline(true);
+	}
+	else
+	{
+		if (!ostm.get_after_newline())
+			ostm.get_ofstream() << ostm.get_delimiter();
+
+		std::string temp = "";
+		temp += val;
+		ostm.escape_str_and_output(temp);
+
+		ostm.set_after_newline(false);
+	}
+
+	return ostm;
+}
+
+inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, mini::csv::NChar val)
+{
+	if (!ostm.get_after_newline())
+		ostm.get_ofstream() << ostm.get_delimiter();
+
+	std::ostringstream os_temp;
+
+	os_temp << static_cast<int>(val.getChar());
+
+	ostm.escape_and_output(os_temp.str());
+
+	ostm.set_after_newline(false);
+
+	return ostm;
+}
+
+inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const mini::csv::timestamp& val)
+{
+	if (!ostm.get_after_newline())
+		ostm.get_ofstream() << ostm.get_delimiter();
+
+	char buf[mini::csv::timestamp::max_text];
+	ostm.escape_and_output(std::string(buf, val.format(buf)));
+
+	ostm.set_after_newline(false);
+
+	return ostm;
+}
+
+inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const mini::csv::decimal& val)
+{
+	if (!ostm.get_after_newline())
+		ostm.get_ofstream() << ostm.get_delimiter();
+
+	char buf[mini::csv::decimal::max_text];
+	ostm.escape_and_output(std::string(buf, val.format(buf)));
+
+	ostm.set_after_newline(false);
+
+	return ostm;
+}
+
+template<>
+inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const char* val)
+{
+	const std::string temp = val;
+
+	ostm << temp;
+
+	return ostm;
+}
+
+inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const float val)
+{
+	if (!ostm.get_after_newline())
+		ostm.get_ofstream() << ostm.get_delimiter();
+
+	// Need a temporary output stream as float output may contains a comma or the delimiter
+	std::ostringstream os_temp;
+
+	if (ostm.get_precision() > 0)
+	{
+		os_temp << std::fixed << std::showpoint << std::setprecision(ostm.get_precision());
+	}
+
+	os_temp << val;
+
+	ostm.escape_and_output(os_temp.str());
+
+	ostm.set_after_newline(false);
+
+	return ostm;
+}
+
+inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const double val)
+{
+	if (!ostm.get_after_newline())
+		ostm.get_ofstream() << ostm.get_delimiter();
+
+	// Need a temporary output stream as float output may contains a comma or the delimiter
+	std::ostringstream os_temp;
+
+	if (ostm.get_precision() > 0)
+	{
+		os_temp << std::fixed << std::showpoint << std::setprecision(ostm.get_precision());
+	}
+
+	os_temp << val;
+
+	ostm.escape_and_output(os_temp.str());
+
+	ostm.set_after_newline(false);
+
+	return ostm;
+}
+
+inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const long double val)
+{
+	if (!ostm.get_after_newline())
+		ostm.get_ofstream() << ostm.get_delimiter();
+
+	// Need a temporary output stream as float output may contains a comma or the delimiter
+	std::ostringstream os_temp;
+
+	if (ostm.get_precision() > 0)
+	{
+		os_temp << std::fixed << std::showpoint << std::setprecision(ostm.get_precision());
+	}
+
+	os_temp << val;
+
+	ostm.escape_and_output(os_temp.str());
+
+	ostm.set_after_newline(false);
+
+	return ostm;
+}
+
+namespace mini
+{
+	namespace csv
+	{
+		class istringstream : public istream_base
+		{
+		public:
+			istringstream()
+				: istream_base()
+				, buf(owned_text.data())
+				, buf_len(0)
+				, buf_pos(0)
+				, buf_eof(false)
+			{
+			}
+			istringstream(const char * text)
+				: istream_base()
+			{
+				set_new_input_string(text);
+			}
+			istringstream(const std::string& text)
+				: istream_base()
+			{
+				set_new_input_string(text);
+			}
+			// Parse the caller's buffer in place without copying it.
+			// The buffer must stay alive and unchanged while it is being read.
+			istringstream(const char * data, size_t size)
+				: istream_base()
+			{
+				reset();
+				set_new_input_buffer(data, size);
+			}
+#ifdef MINICSV_HAS_CPP17
+			istringstream(std::string_view text)
+				: istream_base()
+			{
+				reset();
+				set_new_input_buffer(text);
+			}
+#endif
+			// The moved-to stream carries on from the same position, and the moved-from
+			// stream is left empty
+			istringstream(istringstream&& other)
+				: istream_base()
+				, buf(owned_text.data())
+				, buf_len(0)
+				, buf_pos(0)
+				, buf_eof(false)
+			{
+				move_from(other);
+			}
+			istringstream& operator=(istringstream&& other)
+			{
+				if (this != &other)
+					move_from(other);
+				return *this;
+			}
+			void set_new_input_string(std::string text)
+			{
+				reset();
+				owned_text.swap(text);
+				attach(owned_text.data(), owned_text.size());
+			}
+			// Zero-copy counterpart of set_new_input_string: the delimiter, quote and
+			// escape settings are kept so that the stream can be reused for the next message.
+			void set_new_input_buffer(const char * data, size_t size)
+			{
+				attach(data, size);
+			}
+#ifdef MINICSV_HAS_CPP17
+			void set_new_input_buffer(std::string_view text)
+			{
+				attach(text.data(), text.size());
+			}
+#endif
+			void reset()
+			{
+				clear_line();
+				delimiter = ",";
+				unescape_str = "##";
+				trim_quote_on_str = false;
+				trim_quote = '\"';
+				trim_quote_str = std::string(1, trim_quote);
+				terminate_on_blank_line = true;
+				quote_unescape = "&quot;";
+				line_num = 0;
+				token_num = 0;
+				allow_blank_line = false;
+				field_offsets_enabled = false;
+			}
+			// Sniff the dialect from the unread part of the buffer
+			dialect_info sniff(size_t sample_size = 64 * 1024) const
+			{
+				return sniff_text(buf + buf_pos, std::min(sample_size, buf_len - buf_pos));
+			}
+			void skip_line()
+			{
+				next_line();
+			}
+			bool read_line()
+			{
+				while (!buf_eof)
+				{
+					next_line();
+
+					if (line_len == 0)
+					{
+						if (terminate_on_blank_line)
+							break;
+						else if (allow_blank_line == false)
+							continue;
+					}
+
+					begin_line();
+					return true;
+				}
+				clear_line();
+				return false;
+			}
+#ifdef MINICSV_HAS_COROUTINES
+			// Lazily reads the rows, for (auto row : is.rows()). Field offsets are enabled.
+			generator<row_view> rows()
+			{
+				enable_field_offsets(true);
+				while (read_line())
+					co_yield row_view(*this);
+			}
+#endif
+
+		private:
+			// Copies would read the other stream's text, which they do not own
+			istringstream(const istringstream&);
+			istringstream& operator=(const istringstream&);
+
+			// buf and the line view point into the storage of the stream which owns them,
+			// so they are pointed again at this stream's copy
+			void move_from(istringstream& other)
+			{
+				const bool owned = (other.buf == other.owned_text.data());
+				const view_offset line_at = other.offset_of(other.line_ptr);
+				const view_offset read_at = other.offset_of(other.read_ptr);
+
+				static_cast<istream_base&>(*this) = static_cast<istream_base&>(other);
+				owned_text.swap(other.owned_text);
+				buf = owned ? owned_text.data() : other.buf;
+				buf_len = other.buf_len;
+				buf_pos = other.buf_pos;
+				buf_eof = other.buf_eof;
+				line_ptr = pointer_at(line_at);
+				read_ptr = pointer_at(read_at);
+
+				other.owned_text.clear();
+				other.attach(NULL, 0);
+			}
+			// A view is either in str or in buf, at an offset from its start
+			struct view_offset
+			{
+				bool in_str;
+				size_t offset;
+			};
+			view_offset offset_of(const char* p) const
+			{
+				view_offset at;
+				const std::less_equal<const char*> le;
+				at.in_str = le(str.data(), p) && le(p, str.data() + str.size());
+				at.offset = static_cast<size_t>(p - (at.in_str ? str.data() : buf));
+				return at;
+			}
+			const char* pointer_at(const view_offset& at) const
+			{
+				return (at.in_str ? str.data() : buf) + at.offset;
+			}
+			void attach(const char * data, size_t size)
+			{
+				clear_line();
+				buf = data ? data : "";
+				buf_len = data ? size : 0;
+				buf_pos = 0;
+				buf_eof = false;
+				line_num = 0;
+				token_num = 0;
+			}
+			// Same semantics as std::getline: a trailing newline yields one more empty line
+			void next_line()
+			{
+				if (buf_eof)
+				{
+					clear_line();
+					return;
+				}
+				const char* begin = buf + buf_pos;
+				const size_t remaining = buf_len - buf_pos;
+				const char* nl = (remaining > 0) ? static_cast<const char*>(memchr(begin, NEWLINE, remaining)) : NULL;
+				size_t len = remaining;
+				if (nl)
+				{
+					len = static_cast<size_t>(nl - begin);
+					buf_pos += len + 1;
+				}
+				else
+				{
+					buf_pos = buf_len;
+					buf_eof = true;
+				}
+				set_line(begin, len, false);
+			}
+
+			std::string owned_text;
+			const char* buf;
+			size_t buf_len;
+			size_t buf_pos;
+			bool buf_eof;
+		};
+
+		// std::streambuf which appends straight into a std::string, so that
+		// ostringstream can hand out its text without copying it.
+		class string_appender : public std::streambuf
+		{
+		public:
+			explicit string_appender(std::string* target_) : target(target_) {}
+			void set_target(std::string* target_)
+			{
+				target = target_;
+			}
+			std::string* get_target() const
+			{
+				return target;
+			}
+		protected:
+			virtual int_type overflow(int_type ch)
+			{
+				if (!traits_type::eq_int_type(ch, traits_type::eof()))
+					target->push_back(traits_type::to_char_type(ch));
+
+				return traits_type::not_eof(ch);
+			}
+			virtual std::streamsize xsputn(const char* s, std::streamsize n)
+			{
+				target->append(s, static_cast<size_t>(n));
+				return n;
+			}
+		private:
+			std::string* target;
+		};
+
+		// std::ostream over the text of an ostringstream, with the str() members of
+		// std::ostringstream reading and replacing that text
+		class text_ostream : public std::ostream
+		{
+		public:
+			explicit text_ostream(std::string* target)
+				: std::ostream(NULL)
+				, sbuf(target)
+			{
+				rdbuf(&sbuf);
+			}
+			void set_target(std::string* target)
+			{
+				sbuf.set_target(target);
+			}
+			std::string str() const
+			{
+				return *sbuf.get_target();
+			}
+			void str(const std::string& text)
+			{
+				*sbuf.get_target() = text;
+			}
+		private:
+			text_ostream(const text_ostream&);
+			text_ostream& operator=(const text_ostream&);
+
+			string_appender sbuf;
+		};
+
+		class ostringstream : public ostream_base
+		{
+		public:
+			ostringstream()
+				: ostream_base()
+				, out(&text)
+				, ostm(&text)
+			{
+			}
+			// Append to the caller's string instead of the internal buffer
+			explicit ostringstream(std::string& target)
+				: ostream_base()
+				, out(&target)
+				, ostm(&target)
+			{
+			}
+			// The moved-to stream keeps writing to the same text, and the moved-from
+			// stream is left empty
+			ostringstream(ostringstream&& other)
+				: ostream_base()
+				, out(&text)
+				, ostm(&text)
+			{
+				move_from(other);
+			}
+			ostringstream& operator=(ostringstream&& other)
+			{
+				if (this != &other)
+					move_from(other);
+
+				return *this;
+			}
+			// Writes to the returned stream go straight into the text, and its str() reads
+			// or replaces the text. It is no longer a std::ostringstream, see version 2.1.5.
+			text_ostream& get_ostringstream()
+			{
+				return ostm;
+			}
+			std::string get_text()
+			{
+				return *out;
+			}
+			// Move the text out without copying; the stream is ready for the next document.
+			std::string take_text()
+			{
+				std::string result;
+				result.swap(*out);
+				after_newline = true;
+				return result;
+			}
+			// Discard the text but keep the allocated capacity for reuse
+			void clear()
+			{
+				out->clear();
+				after_newline = true;
+			}
+			void reserve(size_t n)
+			{
+				out->reserve(n);
+			}
+			// Append to the caller's string from now on. Its existing content is kept.
+			void set_output_string(std::string& target)
+			{
+				out = &target;
+				ostm.set_target(&target);
+				after_newline = true;
+			}
+			void escape_and_output(std::string src)
+			{
+				out->append((escape_str.empty()) ? src : replace(src, delimiter, escape_str));
+			}
+			void escape_str_and_output(std::string src)
+			{
+				if (escape_str_in_place(src))
+				{
+					out->push_back(surround_quote);
+					out->append(src);
+					out->push_back(surround_quote);
+				}
+				else
+				{
+					out->append(src);
+				}
+			}
+			// Format all the fields of a row straight into the text buffer
+			template<typename... Ts>
+			void write_row(const Ts&... fields)
+			{
+				format_row(*out, fields...);
+			}
+			template<typename... Ts>
+			void write_row(const std::tuple<Ts...>& fields)
+			{
+				if (!after_newline && sizeof...(Ts) > 0)
+					*out += delimiter;
+				format_tuple(*out, fields, typename make_index_seq<sizeof...(Ts)>::type());
+				*out += NEWLINE;
+				after_newline = true;
+			}
+		private:
+			ostringstream(const ostringstream&);
+			ostringstream& operator=(const ostringstream&);
+			void move_from(ostringstream& other)
+			{
+				static_cast<ostream_base&>(*this) = static_cast<ostream_base&>(other);
+				text.swap(other.text);
+				out = (other.out == &other.text) ? &text : other.out;
+				ostm.set_target(out);
+				ostm.copyfmt(other.ostm);
+				other.text.clear();
+				other.set_output_string(other.text);
+			}
+
+			std::string text;
+			std::string* out;
+			text_ostream ostm;
+		};
+
+
+		// Streams with a compile-time dialect, e.g. fixed_ifstream< dialect<'|', '"', escape::none> >.
+		// The tokenizer and the escaping are specialized on the dialect, so the delimiter and
+		// quote comparisons are constants and the unused escape branches are compiled out.
+		// The stream operators are shared with the runtime streams, so they reach the
+		// specialized tokenizer through one function pointer call per field.
+		// Do not change the delimiter, quote or escapes of these streams at runtime.
+		template<typename Dialect>
+		class fixed_ifstream : public ifstream
+		{
+		public:
+			using ifstream::open;
+			fixed_ifstream(const std::string& file = "")
+				: ifstream(file)
+			{
+				fix_dialect<Dialect>();
+			}
+			fixed_ifstream(const char * file)
+				: ifstream(file)
+			{
+				fix_dialect<Dialect>();
+			}
+			void open(const std::string& file)
+			{
+				ifstream::open(file);
+				fix_dialect<Dialect>();
+			}
+			void open(const char * file)
+			{
+				ifstream::open(file);
+				fix_dialect<Dialect>();
+			}
+			void open(const std::string& file, uint64_t begin, uint64_t end)
+			{
+				ifstream::open(file, begin, end);
+				fix_dialect<Dialect>();
+			}
+			void init()
+			{
+				ifstream::init();
+				fix_dialect<Dialect>();
+			}
+		};
+
+		template<typename Dialect>
+		class fixed_istringstream : public istringstream
+		{
+		public:
+			fixed_istringstream()
+				: istringstream()
+			{
+				fix_dialect<Dialect>();
+			}
+			fixed_istringstream(const char * text)
+				: istringstream(text)
+			{
+				fix_dialect<Dialect>();
+			}
+			fixed_istringstream(const std::string& text)
+				: istringstream(text)
+			{
+				fix_dialect<Dialect>();
+			}
+			fixed_istringstream(const char * data, size_t size)
+				: istringstream(data, size)
+			{
+				fix_dialect<Dialect>();
+			}
+#ifdef MINICSV_HAS_CPP17
+			fixed_istringstream(std::string_view text)
+				: istringstream(text)
+			{
+				fix_dialect<Dialect>();
+			}
+#endif
+			void set_new_input_string(std::string text)
+			{
+				istringstream::set_new_input_string(std::move(text));
+				fix_dialect<Dialect>();
+			}
+			void reset()
+			{
+				istringstream::reset();
+				fix_dialect<Dialect>();
+			}
+		};
+
+		template<typename Dialect>
+		class fixed_ofstream : public ofstream
+		{
+		public:
+			fixed_ofstream(const std::string& file = "")
+				: ofstream(file)
+			{
+				fix_dialect<Dialect>();
+			}
+			fixed_ofstream(const char * file)
+				: ofstream(file)
+			{
+				fix_dialect<Dialect>();
+			}
+			void open(const std::string& file)
+			{
+				ofstream::open(file);
+				fix_dialect<Dialect>();
+			}
+			void open(const char * file)
+			{
+				ofstream::open(file);
+				fix_dialect<Dialect>();
+			}
+			void init()
+			{
+				ofstream::init();
+				fix_dialect<Dialect>();
+			}
+		};
+
+		template<typename Dialect>
+		class fixed_ostringstream : public ostringstream
+		{
+		public:
+			fixed_ostringstream()
+				: ostringstream()
+			{
+				fix_dialect<Dialect>();
+			}
+			explicit fixed_ostringstream(std::string& target)
+				: ostringstream(target)
+			{
+				fix_dialect<Dialect>();
+			}
+		};
+
+	} // ns csv
+} // ns mini
+
+template<typename T>
+mini::csv::istringstream& operator >> (mini::csv::istringstream& istm, T& val)
+{
+	const std::string& str = istm.get_delimited_str();
 
 #ifdef USE_BOOST_LEXICAL_CAST
-	try 
+	try
 	{
 		val = boost::lexical_cast<T>(str);
 	}
 	catch (boost::bad_lexical_cast& e)
 	{
-		throw std::runtime_error(istm.error_line(str, MY_FUNC_SIG).c_str());
+		istm.conversion_error(str, MY_FUNC_SIG);
+		return istm;
 	}
 #else
 	std::istringstream is(str);
 	is >> val;
 	if (!(bool)is)
 	{
-		throw std::runtime_error(istm.error_line(str, MY_FUNC_SIG).c_str());
+		istm.conversion_error(str, MY_FUNC_SIG);
+		return istm;
 	}
 #endif
 
 	return istm;
 }
 template<>
-inline mini::csv::ifstream& operator >> (mini::csv::ifstream& istm, std::string& val)
+inline mini::csv::istringstream& operator >> (mini::csv::istringstream& istm, std::string& val)
 {
 	val = istm.get_delimited_str();
 
@@ -600,14 +4499,14 @@ inline mini::csv::ifstream& operator >> (mini::csv::ifstream& istm, std::string&
 }
 
 template<>
-inline mini::csv::ifstream& operator >> (mini::csv::ifstream& istm, mini::csv::sep& val)
+inline mini::csv::istringstream& operator >> (mini::csv::istringstream& istm, mini::csv::sep& val)
 {
-	istm.set_delimiter(val.get_delimiter(), val.get_escape());
+	istm.set_delimiter(val.get_delimiter_str(), val.get_escape());
 
 	return istm;
 }
 
-inline mini::csv::ifstream& operator >> (mini::csv::ifstream& istm, mini::csv::NChar val)
+inline mini::csv::istringstream& operator >> (mini::csv::istringstream& istm, mini::csv::NChar val)
 {
 	const std::string& str = istm.get_delimited_str();
 
@@ -619,20 +4518,23 @@ inline mini::csv::ifstream& operator >> (mini::csv::ifstream& istm, mini::csv::N
 	}
 	catch (boost::bad_lexical_cast& e)
 	{
-		throw std::runtime_error(istm.error_line(str, MY_FUNC_SIG).c_str());
+		istm.conversion_error(str, MY_FUNC_SIG);
+		return istm;
 	}
 #else
 	std::istringstream is(str);
 	is >> n;
 	if (!(bool)is)
 	{
-		throw std::runtime_error(istm.error_line(str, MY_FUNC_SIG).c_str());
+		istm.conversion_error(str, MY_FUNC_SIG);
+		return istm;
 	}
 #endif
 
 	if (n > 127 || n < -128)
 	{
-		throw std::runtime_error(istm.error_line(str, MY_FUNC_SIG).c_str());
+		istm.conversion_error(str, MY_FUNC_SIG);
+		return istm;
 	}
 
 	char temp = static_cast<char>(n);
@@ -641,14 +4543,41 @@ inline mini::csv::ifstream& operator >> (mini::csv::ifstream& istm, mini::csv::N
 	return istm;
 }
 
+inline mini::csv::istringstream& operator >> (mini::csv::istringstream& istm, mini::csv::timestamp& val)
+{
+	const std::string& str = istm.get_delimited_str();
+
+	if (!val.parse(str))
+	{
+		istm.conversion_error(str, MY_FUNC_SIG);
+		return istm;
+	}
+
+	return istm;
+}
+
+inline mini::csv::istringstream& operator >> (mini::csv::istringstream& istm, mini::csv::decimal& val)
+{
+	const std::string& str = istm.get_delimited_str();
+
+	if (!val.parse(str))
+	{
+		istm.conversion_error(str, MY_FUNC_SIG);
+		return istm;
+	}
+
+	return istm;
+}
+
 template<>
-inline mini::csv::ifstream& operator >> (mini::csv::ifstream& istm, char& val)
+inline mini::csv::istringstream& operator >> (mini::csv::istringstream& istm, char& val)
 {
 	const std::string& src = istm.get_delimited_str();
 
 	if (src.empty())
 	{
-		throw std::runtime_error(istm.error_line(src, MY_FUNC_SIG).c_str());
+		istm.conversion_error(src, MY_FUNC_SIG);
+		return istm;
 	}
 
 	val = src[0];
@@ -657,10 +4586,10 @@ inline mini::csv::ifstream& operator >> (mini::csv::ifstream& istm, char& val)
 }
 
 template<typename T>
-mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const T& val)
+mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const T& val)
 {
-	if(!ostm.get_after_newline())
-		ostm.get_ofstream() << ostm.get_delimiter();
+	if (!ostm.get_after_newline())
+		ostm.get_ostringstream() << ostm.get_delimiter();
 
 	std::ostringstream os_temp;
 
@@ -672,12 +4601,11 @@ mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const T& val)
 
 	return ostm;
 }
-
 template<typename T>
-mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const T* val)
+mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const T* val)
 {
 	if (!ostm.get_after_newline())
-		ostm.get_ofstream() << ostm.get_delimiter();
+		ostm.get_ostringstream() << ostm.get_delimiter();
 
 	std::ostringstream os_temp;
 
@@ -689,12 +4617,11 @@ mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const T* val)
 
 	return ostm;
 }
-
 template<>
-inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const std::string& val)
+inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const std::string& val)
 {
 	if (!ostm.get_after_newline())
-		ostm.get_ofstream() << ostm.get_delimiter();
+		ostm.get_ostringstream() << ostm.get_delimiter();
 
 	std::string temp = val;
 	ostm.escape_str_and_output(temp);
@@ -703,28 +4630,27 @@ inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const std::s
 
 	return ostm;
 }
-
 template<>
-inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const mini::csv::sep& val)
+inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const mini::csv::sep& val)
 {
-	ostm.set_delimiter(val.get_delimiter(), val.get_escape());
+	ostm.set_delimiter(val.get_delimiter_str(), val.get_escape());
 
 	return ostm;
 }
 
 template<>
-inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const char& val)
+inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const char& val)
 {
-	if(val==NEWLINE)
+	if (val == NEWLINE)
 	{
-		ostm.get_ofstream() << NEWLINE;
+		ostm.get_ostringstream() << NEWLINE;
 
 		ostm.set_after_newline(true);
 	}
 	else
 	{
 		if (!ostm.get_after_newline())
-			ostm.get_ofstream() << ostm.get_delimiter();
+			ostm.get_ostringstream() << ostm.get_delimiter();
 
 		std::string temp = "";
 		temp += val;
@@ -736,10 +4662,10 @@ inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const char&
 	return ostm;
 }
 
-inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, mini::csv::NChar val)
+inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, mini::csv::NChar val)
 {
 	if (!ostm.get_after_newline())
-		ostm.get_ofstream() << ostm.get_delimiter();
+		ostm.get_ostringstream() << ostm.get_delimiter();
 
 	std::ostringstream os_temp;
 
@@ -752,8 +4678,34 @@ inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, mini::csv::N
 	return ostm;
 }
 
+inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const mini::csv::timestamp& val)
+{
+	if (!ostm.get_after_newline())
+		ostm.get_ostringstream() << ostm.get_delimiter();
+
+	char buf[mini::csv::timestamp::max_text];
+	ostm.escape_and_output(std::string(buf, val.format(buf)));
+
+	ostm.set_after_newline(false);
+
+	return ostm;
+}
+
+inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const mini::csv::decimal& val)
+{
+	if (!ostm.get_after_newline())
+		ostm.get_ostringstream() << ostm.get_delimiter();
+
+	char buf[mini::csv::decimal::max_text];
+	ostm.escape_and_output(std::string(buf, val.format(buf)));
+
+	ostm.set_after_newline(false);
+
+	return ostm;
+}
+
 template<>
-inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const char* val)
+inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const char* val)
 {
 	const std::string temp = val;
 
@@ -762,10 +4714,54 @@ inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const char*
 	return ostm;
 }
 
-inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const float val)
+inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const float val)
 {
 	if (!ostm.get_after_newline())
-		ostm.get_ofstream() << ostm.get_delimiter();
+		ostm.get_ostringstream() << ostm.get_delimiter();
+
+	// Need a temporary output stream as float output may contains a comma or the delimiter
+	std::ostringstream os_temp;
+
+	if (ostm.get_precision() > 0)
+	{
+		os_temp << std::fixed << std::showpoint << std::setprecision(ostm.get_precision());
+	}
+
+	os_temp << val;
+
+	ostm.escape_and_output(os_temp.str());
+
+	ostm.set_after_newline(false);
+
+	return ostm;
+}
+
+inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const double val)
+{
+	if (!ostm.get_after_newline())
+		ostm.get_ostringstream() << ostm.get_delimiter();
+
+	// Need a temporary output stream as float output may contains a comma or the delimiter
+	std::ostringstream os_temp;
+
+	if (ostm.get_precision() > 0)
+	{
+		os_temp << std::fixed << std::showpoint << std::setprecision(ostm.get_precision());
+	}
+
+	os_temp << val;
+
+	ostm.escape_and_output(os_temp.str());
+
+	ostm.set_after_newline(false);
+
+	return ostm;
+}
+
+inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const long double val)
+{
+	if (!ostm.get_after_newline())
+		ostm.get_ostringstream() << ostm.get_delimiter();
 
 	// Need a temporary output stream as float output may contains a comma or the delimiter
 	std::ostringstream os_temp;
@@ -784,424 +4780,2372 @@ inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const float
 	return ostm;
 }
 
-inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const double val)
-{
-	if (!ostm.get_after_newline())
-		ostm.get_ofstream() << ostm.get_delimiter();
+namespace mini
+{
+	namespace csv
+	{
+		// Reads the next field into val without throwing. Returns false when it does not
+		// convert, in which case the error is recorded as in error collection mode.
+		template<typename Reader, typename T>
+		bool try_read(Reader& is, T& val)
+		{
+			const bool collecting = is.is_collecting_errors();
+			const size_t errors_before = is.error_count();
+			is.enable_error_collection(true);
+			is >> val;
+			is.enable_error_collection(collecting);
+			return is.error_count() == errors_before;
+		}
+
+		// Default row formatter of parallel_writer: tuples and vectors are written
+		// field by field, other types with their own << operator followed by NEWLINE.
+		struct row_formatter
+		{
+			template<typename... Ts>
+			void operator()(ostringstream& os, const std::tuple<Ts...>& row) const
+			{
+				os.write_row(row);
+			}
+			template<typename T>
+			void operator()(ostringstream& os, const std::vector<T>& row) const
+			{
+				for (size_t i = 0; i < row.size(); ++i)
+					os << row[i];
+				os << NEWLINE;
+			}
+			template<typename T>
+			void operator()(ostringstream& os, const T& row) const
+			{
+				os << row << NEWLINE;
+			}
+		};
+
+		// Formats batches of rows on worker threads, each into its own buffer with the
+		// settings of the target ofstream, and writes the buffers to it in row order.
+		// At most two batches per thread are buffered, so memory stays bounded.
+		class parallel_writer
+		{
+		public:
+			explicit parallel_writer(ofstream& os_, size_t threads_ = 0, size_t batch_rows_ = 4096)
+				: os(os_)
+				, threads(threads_ ? threads_ : std::max<size_t>(1, std::thread::hardware_concurrency()))
+				, batch_rows(batch_rows_ ? batch_rows_ : 1)
+			{
+			}
+			template<typename Container>
+			void write(const Container& rows)
+			{
+				write(rows.begin(), rows.end(), row_formatter());
+			}
+			// format(csv::ostringstream&, const Row&) writes one row, NEWLINE included
+			template<typename Iter, typename Formatter>
+			void write(Iter first, Iter last, Formatter format)
+			{
+				std::vector<Iter> starts;
+				for (Iter it = first; it != last;)
+				{
+					starts.push_back(it);
+					for (size_t n = 0; n < batch_rows && it != last; ++n)
+						++it;
+				}
+				starts.push_back(last);
+				const size_t batches = starts.size() - 1;
+				if (batches == 0)
+					return;
+
+				std::vector<std::string> outputs(batches);
+				std::vector<char> done(batches, 0);
+				size_t next_batch = 0;
+				size_t written = 0;
+				bool failed = false;
+				std::exception_ptr error;
+				std::mutex mtx;
+				std::condition_variable cv;
+				const size_t window = threads * 2;
+				const bool first_after_newline = os.get_after_newline();
+				ofstream& target = os;
+
+				auto worker = [&]()
+				{
+					ostringstream fmt;
+					fmt.set_format(target);
+					while (true)
+					{
+						size_t b = 0;
+						{
+							std::unique_lock<std::mutex> lock(mtx);
+							cv.wait(lock, [&]() { return failed || next_batch >= batches || next_batch < written + window; });
+							if (failed || next_batch >= batches)
+								return;
+							b = next_batch++;
+						}
+
+						std::string buf;
+						fmt.set_output_string(buf);
+						fmt.set_after_newline(b == 0 ? first_after_newline : true);
+						try
+						{
+							for (Iter it = starts[b]; it != starts[b + 1]; ++it)
+								format(fmt, *it);
+						}
+						catch (...)
+						{
+							std::lock_guard<std::mutex> lock(mtx);
+							if (!failed)
+								error = std::current_exception();
+							failed = true;
+							cv.notify_all();
+							return;
+						}
+
+						{
+							std::lock_guard<std::mutex> lock(mtx);
+							outputs[b].swap(buf);
+							done[b] = 1;
+						}
+						cv.notify_all();
+					}
+				};
+
+				std::vector<std::thread> pool;
+				for (size_t t = 0; t < std::min(threads, batches); ++t)
+					pool.push_back(std::thread(worker));
+
+				// the calling thread writes the batches in order as they complete
+				while (true)
+				{
+					std::string out;
+					{
+						std::unique_lock<std::mutex> lock(mtx);
+						cv.wait(lock, [&]() { return failed || written >= batches || done[written]; });
+						if (failed || written >= batches)
+							break;
+						out.swap(outputs[written]);
+					}
+					os.get_ofstream().write(out.data(), static_cast<std::streamsize>(out.size()));
+					{
+						std::lock_guard<std::mutex> lock(mtx);
+						++written;
+					}
+					cv.notify_all();
+				}
+
+				for (size_t t = 0; t < pool.size(); ++t)
+					pool[t].join();
+
+				if (error)
+					std::rethrow_exception(error);
+
+				os.set_after_newline(true);
+			}
+		private:
+			ofstream& os;
+			size_t threads;
+			size_t batch_rows;
+		};
+
+		// Column storage of columnar_table: arithmetic values are stored as an array,
+		// text as end offsets into a character blob. The data either belongs to the
+		// column or points into the mapped cache file.
+		template<typename T, bool IsText = std::is_same<T, std::string>::value>
+		class table_column
+		{
+		public:
+			static_assert(std::is_arithmetic<T>::value, "columnar_table columns must be arithmetic or std::string");
+			typedef T value_type;
+
+			table_column() : values(NULL) {}
+			void add(const T& val) { owned.push_back(val); }
+			void clear() { std::vector<T>().swap(owned); values = NULL; }
+			void use_owned() { values = owned.empty() ? NULL : &owned[0]; }
+			T get(size_t row) const { return values[row]; }
+			const T* data() const { return values; }
+
+			static uint8_t type_code() { return static_cast<uint8_t>((std::is_floating_point<T>::value ? 0x20 : (std::is_signed<T>::value ? 0x10 : 0x00)) | sizeof(T)); }
+			size_t byte_size(size_t rows) const { return rows * sizeof(T); }
+			void save(std::ostream& os, size_t rows) const
+			{
+				os.write(reinterpret_cast<const char*>(values), static_cast<std::streamsize>(byte_size(rows)));
+			}
+			// returns the bytes used, or 0 if the mapped section is too small
+			size_t map(const char* p, size_t avail, size_t rows)
+			{
+				if (avail < byte_size(rows))
+					return 0;
+				values = reinterpret_cast<const T*>(p);
+				return byte_size(rows);
+			}
+		private:
+			std::vector<T> owned;
+			const T* values;
+		};
+
+		template<typename T>
+		class table_column<T, true>
+		{
+		public:
+			typedef field_view value_type;
+
+			table_column() : ends(NULL), chars(NULL) {}
+			void add(const std::string& val)
+			{
+				owned_chars += val;
+				owned_ends.push_back(owned_chars.size());
+			}
+			void clear()
+			{
+				std::vector<uint64_t>().swap(owned_ends);
+				std::string().swap(owned_chars);
+				ends = NULL;
+				chars = NULL;
+			}
+			void use_owned()
+			{
+				ends = owned_ends.empty() ? NULL : &owned_ends[0];
+				chars = owned_chars.data();
+			}
+			field_view get(size_t row) const
+			{
+				const uint64_t begin = (row == 0) ? 0 : ends[row - 1];
+				return field_view(chars + begin, static_cast<size_t>(ends[row] - begin));
+			}
+
+			static uint8_t type_code() { return 0x40; }
+			size_t byte_size(size_t rows) const
+			{
+				return rows * sizeof(uint64_t) + (rows ? static_cast<size_t>(ends[rows - 1]) : 0);
+			}
+			void save(std::ostream& os, size_t rows) const
+			{
+				os.write(reinterpret_cast<const char*>(ends), static_cast<std::streamsize>(rows * sizeof(uint64_t)));
+				if (rows)
+					os.write(chars, static_cast<std::streamsize>(ends[rows - 1]));
+			}
+			size_t map(const char* p, size_t avail, size_t rows)
+			{
+				if (avail < rows * sizeof(uint64_t))
+					return 0;
+				const uint64_t* e = reinterpret_cast<const uint64_t*>(p);
+				const uint64_t text_size = rows ? e[rows - 1] : 0;
+				if (avail - rows * sizeof(uint64_t) < text_size)
+					return 0;
+				ends = e;
+				chars = p + rows * sizeof(uint64_t);
+				return rows * sizeof(uint64_t) + static_cast<size_t>(text_size);
+			}
+		private:
+			std::vector<uint64_t> owned_ends;
+			std::string owned_chars;
+			const uint64_t* ends;
+			const char* chars;
+		};
+
+		// Table of typed columns loaded from a CSV file through a binary columnar cache.
+		// The first load parses the file and saves file + ".mcc" next to it; later loads
+		// memory map the cache as long as the file size, modification time and a hash of
+		// the whole file are unchanged.
+		template<typename... Ts>
+		class columnar_table
+		{
+			static_assert(sizeof...(Ts) > 0, "columnar_table needs at least one column");
+			typedef std::tuple<table_column<Ts>...> columns_type;
+		public:
+			columnar_table() : row_count(0), from_cache(false) {}
+
+			size_t rows() const { return row_count; }
+			bool loaded_from_cache() const { return from_cache; }
+
+			// value of column I at row: the arithmetic value, or a field_view for std::string columns
+			template<size_t I>
+			typename std::tuple_element<I, columns_type>::type::value_type get(size_t row) const
+			{
+				return std::get<I>(columns).get(row);
+			}
+			// contiguous values of the arithmetic column I
+			template<size_t I>
+			const typename std::tuple_element<I, std::tuple<Ts...> >::type* column() const
+			{
+				return std::get<I>(columns).data();
+			}
+
+			bool load(const std::string& file)
+			{
+				return load(file, no_configure());
+			}
+			// configure(csv::ifstream&) is called after the file is opened, to set the
+			// delimiter or skip the header line before the rows are parsed.
+			template<typename Configure>
+			bool load(const std::string& file, Configure configure)
+			{
+				return load(file, file + ".mcc", configure);
+			}
+			template<typename Configure>
+			bool load(const std::string& file, const std::string& cache_file, Configure configure)
+			{
+				clear();
+				uint64_t size = 0;
+				int64_t mtime = 0;
+				if (!file_stat(file, size, mtime))
+					return false;
+				ifstream is(file);
+				if (!is.is_open())
+					return false;
+				configure(is);
+				// A cache parsed with other settings, or from another first line, is not reused
+				const uint64_t hash = fingerprint(file);
+				const uint64_t offset = is.get_offset();
+				const uint64_t config = fnv1a(reinterpret_cast<const char*>(&offset), sizeof(offset), is.settings_hash());
+
+				if (map_cache(cache_file, size, mtime, hash, config))
+				{
+					from_cache = true;
+					return true;
+				}
+
+				while (is.read_line())
+				{
+					read_row(is, typename make_index_seq<sizeof...(Ts)>::type());
+					++row_count;
+				}
+				use_owned(typename make_index_seq<sizeof...(Ts)>::type());
+				save_cache(cache_file, size, mtime, hash, config);
+				return true;
+			}
+			void clear()
+			{
+				clear_columns(typename make_index_seq<sizeof...(Ts)>::type());
+				cache.close();
+				row_count = 0;
+				from_cache = false;
+			}
+		private:
+			struct no_configure
+			{
+				void operator()(ifstream&) const {}
+			};
+			struct cache_header
+			{
+				char magic[8];
+				uint64_t source_size;
+				int64_t source_mtime;
+				uint64_t source_hash;
+				uint64_t config_hash;
+				uint64_t rows;
+				uint64_t columns;
+				uint8_t types[sizeof...(Ts)];
+			};
+			static size_t header_size()
+			{
+				return (sizeof(cache_header) + 7) & ~static_cast<size_t>(7);
+			}
+			// XXH64 of the whole file, so that an edit anywhere in it, even within the
+			// same second and to the same size, invalidates the cache
+			static uint64_t fingerprint(const std::string& file)
+			{
+				const size_t block = 1024 * 1024;
+				std::ifstream istm(file.c_str(), std::ios_base::in | std::ios_base::binary);
+				std::vector<char> buf(block);
+				checksum sum(checksum::xxhash64);
+				while (istm.read(&buf[0], block) || istm.gcount() > 0)
+					sum.update(&buf[0], static_cast<size_t>(istm.gcount()));
+				return sum.digest();
+			}
+			template<size_t... I>
+			void read_row(ifstream& is, index_seq<I...>)
+			{
+				int expand[] = { (read_value(is, std::get<I>(columns)), 0)... };
+				(void)expand;
+			}
+			template<typename T>
+			static void read_value(ifstream& is, table_column<T>& col)
+			{
+				T val = T();
+				is >> val;
+				col.add(val);
+			}
+			template<size_t... I>
+			void use_owned(index_seq<I...>)
+			{
+				int expand[] = { (std::get<I>(columns).use_owned(), 0)... };
+				(void)expand;
+			}
+			template<size_t... I>
+			void clear_columns(index_seq<I...>)
+			{
+				int expand[] = { (std::get<I>(columns).clear(), 0)... };
+				(void)expand;
+			}
+			template<size_t... I>
+			void fill_types(cache_header& header, index_seq<I...>) const
+			{
+				int expand[] = { (header.types[I] = table_column<Ts>::type_code(), 0)... };
+				(void)expand;
+			}
+			template<size_t... I>
+			void save_columns(std::ostream& os, index_seq<I...>) const
+			{
+				int expand[] = { (std::get<I>(columns).save(os, row_count), pad(os, std::get<I>(columns).byte_size(row_count)), 0)... };
+				(void)expand;
+			}
+			template<size_t... I>
+			bool map_columns(const char* p, size_t avail, index_seq<I...>)
+			{
+				bool ok = true;
+				int expand[] = { (ok = ok && map_column(std::get<I>(columns), p, avail), 0)... };
+				(void)expand;
+				return ok;
+			}
+			template<typename Column>
+			bool map_column(Column& col, const char*& p, size_t& avail)
+			{
+				size_t used = col.map(p, avail, row_count);
+				if (used == 0 && row_count > 0)
+					return false;
+				used = (used + 7) & ~static_cast<size_t>(7);
+				if (used > avail)
+					used = avail;
+				p += used;
+				avail -= used;
+				return true;
+			}
+			static void pad(std::ostream& os, size_t written)
+			{
+				const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+				const size_t n = ((written + 7) & ~static_cast<size_t>(7)) - written;
+				os.write(zeros, static_cast<std::streamsize>(n));
+			}
+			void init_header(cache_header& header, uint64_t size, int64_t mtime, uint64_t hash, uint64_t config) const
+			{
+				memset(&header, 0, sizeof(header));
+				memcpy(header.magic, "MCSVCOL2", 8);
+				header.source_size = size;
+				header.source_mtime = mtime;
+				header.source_hash = hash;
+				header.config_hash = config;
+				header.rows = row_count;
+				header.columns = sizeof...(Ts);
+				fill_types(header, typename make_index_seq<sizeof...(Ts)>::type());
+			}
+			bool map_cache(const std::string& cache_file, uint64_t size, int64_t mtime, uint64_t hash, uint64_t config)
+			{
+				if (!cache.open(cache_file) || cache.size() < header_size())
+					return false;
+
+				cache_header expected;
+				init_header(expected, size, mtime, hash, config);
+				cache_header header;
+				memcpy(&header, cache.data(), sizeof(header));
+				expected.rows = header.rows;
+				if (memcmp(&header, &expected, sizeof(header)) != 0)
+				{
+					cache.close();
+					return false;
+				}
+
+				row_count = static_cast<size_t>(header.rows);
+				if (!map_columns(cache.data() + header_size(), cache.size() - header_size(), typename make_index_seq<sizeof...(Ts)>::type()))
+				{
+					clear();
+					return false;
+				}
+				return true;
+			}
+			void save_cache(const std::string& cache_file, uint64_t size, int64_t mtime, uint64_t hash, uint64_t config) const
+			{
+				// a name of its own, so that loads racing on the same cache do not write into
+				// each other's file; the last rename wins with a whole cache
+				const std::string temp_file = unique_temp_name(cache_file);
+				{
+					std::ofstream os(temp_file.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+					if (!os.is_open())
+						return;
+					cache_header header;
+					init_header(header, size, mtime, hash, config);
+					os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+					pad(os, sizeof(header));
+					save_columns(os, typename make_index_seq<sizeof...(Ts)>::type());
+					if (!os)
+					{
+						os.close();
+						std::remove(temp_file.c_str());
+						return;
+					}
+				}
+				std::remove(cache_file.c_str());
+				std::rename(temp_file.c_str(), cache_file.c_str());
+			}
 
-	// Need a temporary output stream as float output may contains a comma or the delimiter
-	std::ostringstream os_temp;
+			columns_type columns;
+			size_t row_count;
+			bool from_cache;
+			mapped_file cache;
+		};
 
-	if (ostm.get_precision() > 0)
-	{
-		os_temp << std::fixed << std::showpoint << std::setprecision(ostm.get_precision());
-	}
+		// Temporary files of an output go next to it, or in temp_dir when it is set
+		inline std::string temp_file_prefix(const std::string& output, const std::string& temp_dir)
+		{
+			if (temp_dir.empty())
+				return output;
+			const size_t slash = output.find_last_of("/\\");
+			return temp_dir + "/" + ((slash == std::string::npos) ? output : output.substr(slash + 1));
+		}
 
-	os_temp << val;
+		// Bounded-memory sort of a CSV file by key columns. Runs of at most memory_budget
+		// bytes are split between the threads, sorted and spilled to temporary files in
+		// parallel, then merged k ways. Lines are written back unchanged, so quoting and
+		// escaping are kept, while the keys are compared unquoted and unescaped. The sort
+		// is stable.
+		class external_sorter
+		{
+		public:
+			explicit external_sorter(size_t memory_budget_ = 256 * 1024 * 1024, size_t threads_ = 0)
+				: memory_budget(memory_budget_ ? memory_budget_ : 1)
+				, threads(threads_ ? threads_ : std::max<size_t>(1, std::thread::hardware_concurrency()))
+				, has_header(false)
+				, fan_in(64)
+			{
+			}
+			// Keys are compared in the order they are added. Numeric keys compare as numbers,
+			// fields which are not numbers sort after them, as text.
+			void add_key(size_t column, bool numeric = false, bool descending = false)
+			{
+				keys.push_back(sort_key(column, numeric, descending));
+			}
+			// Copy the first line to the output without sorting it
+			void set_header(bool has_header_)
+			{
+				has_header = has_header_;
+			}
+			// Directory of the temporary run files, the output directory by default
+			void set_temp_dir(const std::string& dir)
+			{
+				temp_dir = dir;
+			}
+			bool sort(const std::string& input, const std::string& output)
+			{
+				return sort(input, output, no_configure());
+			}
+			// configure(csv::istream_base&) sets the delimiter, quote and escapes of the file
+			template<typename Configure>
+			bool sort(const std::string& input, const std::string& output, Configure configure)
+			{
+				ifstream is(input);
+				if (!is.is_open())
+					return false;
+				configure(is);
+				// blank lines are skipped, like the other batch tools do
+				is.enable_terminate_on_blank_line(false);
+				is.enable_field_offsets(true);
+
+				std::ofstream os(output.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+				if (!os.is_open())
+					return false;
+				if (has_header && is.read_line())
+					os << is.get_line() << NEWLINE;
+
+				const std::string prefix = temp_file_prefix(output, temp_dir) + ".run";
+				std::vector<std::string> runs;
+				bool ok = true;
+				run_data chunk;
+				while (ok && is.read_line())
+				{
+					chunk.add(is, keys);
+					if (chunk.bytes() >= memory_budget)
+					{
+						ok = spill(chunk, prefix, runs);
+						chunk.clear();
+					}
+				}
+				if (ok && chunk.size() > 0)
+					ok = spill(chunk, prefix, runs);
 
-	ostm.escape_and_output(os_temp.str());
+				// merge groups of runs until few enough are left to merge into the output
+				size_t generation = 0;
+				while (ok && runs.size() > fan_in)
+				{
+					std::vector<std::string> merged;
+					for (size_t i = 0; ok && i < runs.size(); i += fan_in)
+					{
+						std::vector<std::string> group(runs.begin() + i, runs.begin() + std::min(runs.size(), i + fan_in));
+						std::ostringstream name;
+						name << prefix << "m" << generation << "_" << merged.size();
+						std::ofstream ros(name.str().c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+						ok = ros.is_open() && merge(group, ros, configure);
+						remove_files(group);
+						merged.push_back(name.str());
+					}
+					runs.swap(merged);
+					++generation;
+				}
+				if (ok)
+					ok = merge(runs, os, configure);
+				remove_files(runs);
+				return ok && bool(os);
+			}
+		private:
+			struct no_configure
+			{
+				void operator()(istream_base&) const {}
+			};
+			struct sort_key
+			{
+				sort_key(size_t column_, bool numeric_, bool descending_) : column(column_), numeric(numeric_), descending(descending_) {}
+				size_t column;
+				bool numeric;
+				bool descending;
+			};
+			struct key_value
+			{
+				double num;
+				bool is_num;
+				size_t begin;
+				size_t len;
+			};
+			// lines and their keys, stored in one arena
+			class run_data
+			{
+			public:
+				void add(istream_base& is, const std::vector<sort_key>& keys)
+				{
+					const std::string& line = is.get_line();
+					line_begin.push_back(arena.size());
+					line_len.push_back(line.size());
+					arena += line;
+					for (size_t k = 0; k < keys.size(); ++k)
+						values.push_back(extract_key(is, keys[k], arena));
+				}
+				size_t size() const { return line_begin.size(); }
+				size_t bytes() const
+				{
+					return arena.size() + line_begin.size() * 2 * sizeof(size_t) + values.size() * sizeof(key_value);
+				}
+				void clear()
+				{
+					arena.clear();
+					line_begin.clear();
+					line_len.clear();
+					values.clear();
+				}
+				std::string arena;
+				std::vector<size_t> line_begin;
+				std::vector<size_t> line_len;
+				std::vector<key_value> values;
+			};
+			static key_value extract_key(istream_base& is, const sort_key& key, std::string& arena)
+			{
+				key_value v;
+				v.num = 0.0;
+				v.is_num = false;
+				const std::string& text = (key.column < is.field_count()) ? is.field(key.column) : empty_string();
+				if (key.numeric && !text.empty())
+				{
+					char* end = NULL;
+					v.num = strtod(text.c_str(), &end);
+					v.is_num = (end == text.c_str() + text.size());
+				}
+				v.begin = arena.size();
+				v.len = text.size();
+				arena += text;
+				return v;
+			}
+			static const std::string& empty_string()
+			{
+				static const std::string empty;
+				return empty;
+			}
+			int compare(const key_value* a, const char* a_arena, const key_value* b, const char* b_arena) const
+			{
+				for (size_t k = 0; k < keys.size(); ++k)
+				{
+					int c = 0;
+					if (a[k].is_num && b[k].is_num)
+						c = (a[k].num < b[k].num) ? -1 : (b[k].num < a[k].num ? 1 : 0);
+					else if (a[k].is_num != b[k].is_num)
+						c = a[k].is_num ? -1 : 1;
+					else
+					{
+						c = memcmp(a_arena + a[k].begin, b_arena + b[k].begin, std::min(a[k].len, b[k].len));
+						if (c == 0)
+							c = (a[k].len < b[k].len) ? -1 : (a[k].len > b[k].len ? 1 : 0);
+					}
+					if (c != 0)
+						return keys[k].descending ? -c : c;
+				}
+				return 0;
+			}
+			// sort the chunk in one slice per thread, each slice becomes a run file
+			bool spill(const run_data& chunk, const std::string& prefix, std::vector<std::string>& runs)
+			{
+				const size_t n = chunk.size();
+				const size_t slices = std::max<size_t>(1, std::min(threads, n / 1024 + 1));
+				const size_t first_run = runs.size();
+				for (size_t t = 0; t < slices; ++t)
+				{
+					std::ostringstream name;
+					name << prefix << runs.size();
+					runs.push_back(name.str());
+				}
 
-	ostm.set_after_newline(false);
+				std::vector<char> results(slices, 0);
+				std::vector<std::thread> pool;
+				for (size_t t = 0; t < slices; ++t)
+				{
+					pool.push_back(std::thread([&, t]()
+					{
+						const size_t begin = n * t / slices;
+						const size_t end = n * (t + 1) / slices;
+						std::vector<size_t> order;
+						for (size_t i = begin; i < end; ++i)
+							order.push_back(i);
+
+						const size_t nkeys = keys.size();
+						const char* arena = chunk.arena.data();
+						std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+						{
+							return compare(chunk.values.data() + a * nkeys, arena, chunk.values.data() + b * nkeys, arena) < 0;
+						});
 
-	return ostm;
-}
+						std::ofstream ros(runs[first_run + t].c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+						for (size_t i = 0; i < order.size() && ros; ++i)
+						{
+							ros.write(arena + chunk.line_begin[order[i]], static_cast<std::streamsize>(chunk.line_len[order[i]]));
+							ros.put(NEWLINE);
+						}
+						results[t] = ros ? 1 : 0;
+					}));
+				}
+				for (size_t t = 0; t < pool.size(); ++t)
+					pool[t].join();
 
-inline mini::csv::ofstream& operator << (mini::csv::ofstream& ostm, const long double val)
-{
-	if (!ostm.get_after_newline())
-		ostm.get_ofstream() << ostm.get_delimiter();
+				return std::find(results.begin(), results.end(), 0) == results.end();
+			}
+			// run reader for the k-way merge
+			struct run_cursor
+			{
+				ifstream is;
+				std::string arena;
+				std::vector<key_value> values;
+			};
+			bool advance(run_cursor& cur)
+			{
+				if (!cur.is.read_line())
+					return false;
+				cur.arena.clear();
+				cur.values.clear();
+				for (size_t k = 0; k < keys.size(); ++k)
+					cur.values.push_back(extract_key(cur.is, keys[k], cur.arena));
+				return true;
+			}
+			template<typename Configure>
+			bool merge(const std::vector<std::string>& runs, std::ostream& os, Configure& configure)
+			{
+				std::vector<run_cursor*> cursors;
+				for (size_t i = 0; i < runs.size(); ++i)
+				{
+					run_cursor* cur = new run_cursor();
+					cur->is.open(runs[i]);
+					configure(cur->is);
+					cur->is.enable_terminate_on_blank_line(false);
+					cur->is.enable_field_offsets(true);
+					cursors.push_back(cur);
+				}
 
-	// Need a temporary output stream as float output may contains a comma or the delimiter
-	std::ostringstream os_temp;
+				// a later run only wins on strictly smaller keys, which keeps the sort stable
+				const external_sorter& self = *this;
+				auto greater = [&](size_t a, size_t b)
+				{
+					const int c = self.compare(cursors[a]->values.data(), cursors[a]->arena.data(), cursors[b]->values.data(), cursors[b]->arena.data());
+					return c > 0 || (c == 0 && a > b);
+				};
+				std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+				for (size_t i = 0; i < cursors.size(); ++i)
+				{
+					if (advance(*cursors[i]))
+						heap.push(i);
+				}
+				while (!heap.empty() && os)
+				{
+					const size_t i = heap.top();
+					heap.pop();
+					os << cursors[i]->is.get_line() << NEWLINE;
+					if (advance(*cursors[i]))
+						heap.push(i);
+				}
+				for (size_t i = 0; i < cursors.size(); ++i)
+					delete cursors[i];
+				return bool(os);
+			}
+			static void remove_files(const std::vector<std::string>& files)
+			{
+				for (size_t i = 0; i < files.size(); ++i)
+					std::remove(files[i].c_str());
+			}
 
-	if (ostm.get_precision() > 0)
-	{
-		os_temp << std::fixed << std::showpoint << std::setprecision(ostm.get_precision());
-	}
+			size_t memory_budget;
+			size_t threads;
+			bool has_header;
+			size_t fan_in;
+			std::string temp_dir;
+			std::vector<sort_key> keys;
+		};
 
-	os_temp << val;
+		// Hands out blocks of whole lines of a file so that several threads can parse it.
+		// The calls to next() must be serialized by the caller.
+		class line_block_reader
+		{
+		public:
+			explicit line_block_reader(size_t block_size_ = 4 * 1024 * 1024) : block_size(block_size_ ? block_size_ : 1) {}
+			// Skips the UTF-8 BOM, and the first line when has_header is set
+			bool open(const std::string& file, bool has_header)
+			{
+				in.close();
+				in.clear();
+				header.clear();
+				in.open(file.c_str(), std::ios_base::in | std::ios_base::binary);
+				if (!in.is_open())
+					return false;
+
+				char bom[3] = { 0, 0, 0 };
+				in.read(bom, 3);
+				if (!(in.gcount() == 3 && bom[0] == (char)0xEF && bom[1] == (char)0xBB && bom[2] == (char)0xBF))
+				{
+					in.clear();
+					in.seekg(0);
+				}
+				if (has_header)
+				{
+					std::getline(in, header);
+					if (!header.empty() && header[header.size() - 1] == '\r')
+						header.erase(header.size() - 1);
+				}
+				return true;
+			}
+			const std::string& get_header() const
+			{
+				return header;
+			}
+			// A block is extended to the end of its last line
+			bool next(std::string& block)
+			{
+				block.clear();
+				if (!in)
+					return false;
+				block.resize(block_size);
+				in.read(&block[0], static_cast<std::streamsize>(block_size));
+				block.resize(static_cast<size_t>(in.gcount()));
+				std::string rest;
+				if (!block.empty() && block[block.size() - 1] != '\n' && std::getline(in, rest))
+					block += rest;
+				return !block.empty();
+			}
+			// Number of lines of a block which read_line returns and numbers. Blank lines
+			// are skipped without a number, so they are not counted.
+			static size_t count_lines(const std::string& block)
+			{
+				size_t lines = 0;
+				const char* p = block.data();
+				const char* end = p + block.size();
+				while (p < end)
+				{
+					const char* nl = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+					if (nl == NULL)
+						nl = end;
+					if (nl > p)
+						++lines;
+					p = nl + 1;
+				}
+				return lines;
+			}
+		private:
+			size_t block_size;
+			std::ifstream in;
+			std::string header;
+		};
 
-	ostm.escape_and_output(os_temp.str());
+		// Decoded fields of the columns, length-prefixed and concatenated into key.
+		// Missing fields are empty.
+		inline void make_key(istream_base& is, const std::vector<size_t>& columns, std::string& key)
+		{
+			key.clear();
+			for (size_t k = 0; k < columns.size(); ++k)
+			{
+				uint32_t len = 0;
+				if (columns[k] < is.field_count())
+				{
+					const std::string& text = is.field(columns[k]);
+					len = static_cast<uint32_t>(text.size());
+					key.append(reinterpret_cast<const char*>(&len), sizeof(len));
+					key += text;
+				}
+				else
+					key.append(reinterpret_cast<const char*>(&len), sizeof(len));
+			}
+		}
+		// Splits a key made by make_key back into its fields
+		inline std::vector<std::string> split_key(field_view key)
+		{
+			std::vector<std::string> fields;
+			const char* p = key.data();
+			const char* end = p + key.size();
+			while (p + sizeof(uint32_t) <= end)
+			{
+				uint32_t len = 0;
+				memcpy(&len, p, sizeof(len));
+				fields.push_back(std::string(p + sizeof(len), len));
+				p += sizeof(len) + len;
+			}
+			return fields;
+		}
 
-	ostm.set_after_newline(false);
+		// Open addressing set of keys stored in one arena. Each distinct key gets a
+		// dense id, in the order the keys were first interned.
+		class key_interner
+		{
+		public:
+			static const size_t npos = static_cast<size_t>(-1);
 
-	return ostm;
-}
+			key_interner() : slots(64, 0) {}
+			size_t find(const char* data, size_t len) const
+			{
+				return find(data, len, fnv1a(data, len));
+			}
+			size_t find(const std::string& key) const
+			{
+				return find(key.data(), key.size());
+			}
+			size_t find(const char* data, size_t len, uint64_t hash) const
+			{
+				size_t i = static_cast<size_t>(hash) & (slots.size() - 1);
+				while (slots[i] != 0)
+				{
+					const size_t id = slots[i] - 1;
+					if (hashes[id] == hash && key_len[id] == len && memcmp(arena.data() + key_begin[id], data, len) == 0)
+						return id;
+					i = (i + 1) & (slots.size() - 1);
+				}
+				return npos;
+			}
+			// returns the id of the key, adding it if it is new
+			size_t intern(const char* data, size_t len)
+			{
+				return intern(data, len, fnv1a(data, len));
+			}
+			size_t intern(const std::string& key)
+			{
+				return intern(key.data(), key.size());
+			}
+			size_t intern(const char* data, size_t len, uint64_t hash)
+			{
+				const size_t id = find(data, len, hash);
+				return (id != npos) ? id : add(data, len, hash);
+			}
+			// adds a key known to be new, without comparing it with the others
+			size_t add(const char* data, size_t len, uint64_t hash)
+			{
+				size_t i = static_cast<size_t>(hash) & (slots.size() - 1);
+				while (slots[i] != 0)
+					i = (i + 1) & (slots.size() - 1);
+				const size_t id = hashes.size();
+				hashes.push_back(hash);
+				key_begin.push_back(arena.size());
+				key_len.push_back(len);
+				arena.append(data, len);
+				slots[i] = id + 1;
+				if (hashes.size() * 2 > slots.size())
+					grow();
+				return id;
+			}
+			// approximate heap usage in bytes
+			size_t memory() const
+			{
+				return arena.size() + hashes.size() * (sizeof(uint64_t) + 2 * sizeof(size_t)) + slots.size() * sizeof(size_t);
+			}
+			size_t size() const
+			{
+				return hashes.size();
+			}
+			field_view key(size_t id) const
+			{
+				return field_view(arena.data() + key_begin[id], key_len[id]);
+			}
+		private:
+			void grow()
+			{
+				std::vector<size_t> bigger(slots.size() * 2, 0);
+				for (size_t id = 0; id < hashes.size(); ++id)
+				{
+					size_t i = static_cast<size_t>(hashes[id]) & (bigger.size() - 1);
+					while (bigger[i] != 0)
+						i = (i + 1) & (bigger.size() - 1);
+					bigger[i] = id + 1;
+				}
+				slots.swap(bigger);
+			}
+			std::vector<size_t> slots; // key id + 1, 0 for an empty slot
+			std::vector<uint64_t> hashes;
+			std::vector<size_t> key_begin;
+			std::vector<size_t> key_len;
+			std::string arena;
+		};
 
-namespace mini
-{
-	namespace csv
-	{
-		class istringstream : public istream_base
+		// Streaming group-by over a CSV file. Blocks of lines are parsed on worker threads
+		// into thread-local hash tables, which are merged once the file is read. Group keys
+		// are decoded into a reused buffer and only copied when a new group is found.
+		// Fields which are not numbers are left out of sum, min, max and mean.
+		class group_aggregator
 		{
 		public:
-			istringstream(const char * text)
-				: istream_base()
+			enum op { sum, count, min, max, mean };
+			struct group
+			{
+				std::vector<std::string> keys;
+				std::vector<double> values; // in the order the aggregates were added
+			};
+			explicit group_aggregator(size_t threads_ = 0, size_t block_size_ = 4 * 1024 * 1024)
+				: threads(threads_ ? threads_ : std::max<size_t>(1, std::thread::hardware_concurrency()))
+				, block_size(block_size_)
+				, has_header(false)
 			{
-				set_new_input_string(text);
 			}
-			istringstream(const std::string& text)
-				: istream_base()
+			void group_by(size_t column)
 			{
-				set_new_input_string(text);
+				key_columns.push_back(column);
 			}
-			void set_new_input_string(const std::string& text)
+			// count ignores the column and counts the rows of the group
+			void add(op operation, size_t column = 0)
 			{
-				reset();
-				istm.str(text);
-				istm.clear();
+				aggregates.push_back(aggregate(operation, column));
 			}
-			void reset()
+			// Skip the first line of the file
+			void set_header(bool has_header_)
 			{
-				str = "";
-				pos = 0;
-				delimiter = ",";
-				unescape_str = "##";
-				trim_quote_on_str = false;
-				trim_quote = '\"';
-				trim_quote_str = std::string(1, trim_quote);
-				terminate_on_blank_line = true;
-				quote_unescape = "&quot;";
-				line_num = 0;
-				token_num = 0;
-				allow_blank_line = false;
+				has_header = has_header_;
 			}
-			void skip_line()
+			bool run(const std::string& file)
 			{
-				std::getline(istm, str);
-				pos = 0;
+				return run(file, no_configure());
 			}
-			bool read_line()
+			// configure(csv::istream_base&) sets the delimiter, quote and escapes of the file.
+			// Blank lines are skipped.
+			template<typename Configure>
+			bool run(const std::string& file, Configure configure)
 			{
-				this->str = "";
-				while (!istm.eof())
+				result.clear();
+				line_block_reader reader(block_size);
+				if (!reader.open(file, has_header))
+					return false;
+
+				std::vector<group_table> tables(threads);
+				std::mutex mtx;
+				std::exception_ptr error;
+				auto worker = [&](size_t t)
 				{
-					std::getline(istm, this->str);
-					pos = 0;
-
-					if (this->str.empty())
+					try
 					{
-						if (terminate_on_blank_line)
-							break;
-						else if (allow_blank_line == false)
-							continue;
+						istringstream is;
+						configure(is);
+						is.enable_field_offsets(true);
+						is.enable_terminate_on_blank_line(false);
+						is.enable_blank_line(false);
+						std::string block;
+						std::string key;
+						while (true)
+						{
+							{
+								std::lock_guard<std::mutex> lock(mtx);
+								if (error || !reader.next(block))
+									return;
+							}
+							is.set_new_input_buffer(block.data(), block.size());
+							while (is.read_line())
+								accumulate(is, key, tables[t]);
+						}
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(mtx);
+						if (!error)
+							error = std::current_exception();
+					}
+				};
+
+				std::vector<std::thread> pool;
+				for (size_t t = 0; t < threads; ++t)
+					pool.push_back(std::thread(worker, t));
+				for (size_t t = 0; t < pool.size(); ++t)
+					pool[t].join();
+				if (error)
+					std::rethrow_exception(error);
+
+				for (size_t t = 1; t < tables.size(); ++t)
+					tables[0].merge(tables[t], aggregates.size());
+				tables[0].extract(aggregates, result);
+				return true;
+			}
+			// Groups sorted by their keys. min, max and mean are NaN for a group without
+			// any numeric value in their column.
+			const std::vector<group>& results() const
+			{
+				return result;
+			}
+			// Writes one row per group, the keys followed by the aggregates. The aggregates
+			// are written with as many digits as they need to read back the same, unless
+			// set_precision was called on os. A NaN aggregate is written as an empty field.
+			void write(ofstream& os) const
+			{
+				for (size_t g = 0; g < result.size(); ++g)
+				{
+					for (size_t k = 0; k < result[g].keys.size(); ++k)
+						os << result[g].keys[k];
+					for (size_t a = 0; a < result[g].values.size(); ++a)
+					{
+						if (std::isnan(result[g].values[a]))
+							os << std::string();
+						else if (os.get_precision() > 0)
+							os << result[g].values[a];
+						else
+							write_exact(os, result[g].values[a]);
+					}
+					os << NEWLINE;
+				}
+			}
+		private:
+			static void write_exact(ofstream& os, double val)
+			{
+				char buf[32];
+				int n = snprintf(buf, sizeof(buf), "%.15g", val);
+				if (strtod(buf, NULL) != val)
+					n = snprintf(buf, sizeof(buf), "%.17g", val);
+
+				if (!os.get_after_newline())
+					os.get_ofstream() << os.get_delimiter();
+				os.escape_and_output(std::string(buf, static_cast<size_t>(n)));
+				os.set_after_newline(false);
+			}
+			struct no_configure
+			{
+				void operator()(istream_base&) const {}
+			};
+			struct aggregate
+			{
+				aggregate(op operation_, size_t column_) : operation(operation_), column(column_) {}
+				op operation;
+				size_t column;
+			};
+			struct aggregate_state
+			{
+				aggregate_state() : sum(0.0), min(0.0), max(0.0), count(0) {}
+				void add(double v)
+				{
+					if (count == 0 || v < min)
+						min = v;
+					if (count == 0 || v > max)
+						max = v;
+					sum += v;
+					++count;
+				}
+				void merge(const aggregate_state& other)
+				{
+					if (other.count == 0)
+						return;
+					if (count == 0 || other.min < min)
+						min = other.min;
+					if (count == 0 || other.max > max)
+						max = other.max;
+					sum += other.sum;
+					count += other.count;
+				}
+				double sum;
+				double min;
+				double max;
+				uint64_t count;
+			};
+			// groups of one thread, indexed by the key id
+			struct group_table
+			{
+				size_t find_or_add(const char* key, size_t len, size_t naggregates)
+				{
+					const size_t g = keys.intern(key, len);
+					if (g == rows.size())
+					{
+						rows.push_back(0);
+						states.resize(states.size() + naggregates);
+					}
+					return g;
+				}
+				void merge(const group_table& other, size_t naggregates)
+				{
+					for (size_t g = 0; g < other.keys.size(); ++g)
+					{
+						const field_view key = other.keys.key(g);
+						const size_t mine = find_or_add(key.data(), key.size(), naggregates);
+						rows[mine] += other.rows[g];
+						for (size_t a = 0; a < naggregates; ++a)
+							states[mine * naggregates + a].merge(other.states[g * naggregates + a]);
+					}
+				}
+				void extract(const std::vector<aggregate>& aggregates, std::vector<group>& out) const
+				{
+					const size_t naggregates = aggregates.size();
+					out.resize(keys.size());
+					for (size_t g = 0; g < keys.size(); ++g)
+					{
+						out[g].keys = split_key(keys.key(g));
+						for (size_t a = 0; a < naggregates; ++a)
+						{
+							const aggregate_state& st = states[g * naggregates + a];
+							const double none = std::numeric_limits<double>::quiet_NaN();
+							double v = 0.0;
+							switch (aggregates[a].operation)
+							{
+							case sum: v = st.sum; break;
+							case count: v = static_cast<double>(rows[g]); break;
+							case min: v = st.count ? st.min : none; break;
+							case max: v = st.count ? st.max : none; break;
+							case mean: v = st.count ? st.sum / static_cast<double>(st.count) : none; break;
+							}
+							out[g].values.push_back(v);
+						}
 					}
-
-					++line_num;
-					token_num = 0;
-					return true;
+					std::sort(out.begin(), out.end(), [](const group& a, const group& b) { return a.keys < b.keys; });
+				}
+				key_interner keys;
+				std::vector<uint64_t> rows;
+				std::vector<aggregate_state> states;
+			};
+			void accumulate(istream_base& is, std::string& key, group_table& table) const
+			{
+				make_key(is, key_columns, key);
+				const size_t naggregates = aggregates.size();
+				const size_t g = table.find_or_add(key.data(), key.size(), naggregates);
+				++table.rows[g];
+				for (size_t a = 0; a < naggregates; ++a)
+				{
+					if (aggregates[a].operation == count || aggregates[a].column >= is.field_count())
+						continue;
+					const std::string& text = is.field(aggregates[a].column);
+					if (text.empty())
+						continue;
+					char* end = NULL;
+					const double v = strtod(text.c_str(), &end);
+					if (end == text.c_str() + text.size())
+						table.states[g * naggregates + a].add(v);
 				}
-				return false;
 			}
 
-		private:
-			std::istringstream istm;
+			size_t threads;
+			size_t block_size;
+			bool has_header;
+			std::vector<size_t> key_columns;
+			std::vector<aggregate> aggregates;
+			std::vector<group> result;
 		};
 
-		class ostringstream : public ostream_base
+		// Hash join of a large probe file with a small build file on key columns. The
+		// build file is loaded into memory with its keys interned, then blocks of the probe
+		// file are joined on worker threads and written in order through the ofstream.
+		// A joined row holds the probe fields followed by the build fields. A left join
+		// keeps the probe rows without a match, with empty build fields.
+		class hash_joiner
 		{
 		public:
-			ostringstream()
-				: ostream_base()
+			enum join_type { inner, left };
+
+			explicit hash_joiner(size_t threads_ = 0, size_t block_size_ = 4 * 1024 * 1024)
+				: threads(threads_ ? threads_ : std::max<size_t>(1, std::thread::hardware_concurrency()))
+				, block_size(block_size_)
+				, has_header(false)
+				, type(inner)
+				, build_width(0)
 			{
 			}
-			std::ostringstream& get_ostringstream()
+			// Rows match when the probe column equals the build column, for every pair added
+			void on(size_t probe_column, size_t build_column)
 			{
-				return ostm;
+				probe_columns.push_back(probe_column);
+				build_columns.push_back(build_column);
 			}
-			std::string get_text()
+			void set_type(join_type type_)
 			{
-				return ostm.str();
+				type = type_;
 			}
-			void escape_and_output(std::string src)
+			// Both files start with a header, the joined header is written first
+			void set_header(bool has_header_)
 			{
-				ostm << ((escape_str.empty()) ? src : replace(src, delimiter, escape_str));
+				has_header = has_header_;
 			}
-			void escape_str_and_output(std::string src)
+			bool run(const std::string& build_file, const std::string& probe_file, ofstream& os)
 			{
-				src = ((escape_str.empty()) ? src : replace(src, delimiter, escape_str));
-				if (!newline_escape.empty())
+				return run(build_file, probe_file, os, no_configure());
+			}
+			// configure(csv::istream_base&) sets the delimiter, quote and escapes of both files.
+			// Blank lines are skipped.
+			template<typename Configure>
+			bool run(const std::string& build_file, const std::string& probe_file, ofstream& os, Configure configure)
+			{
+				std::string build_header;
+				if (!build(build_file, build_header, configure))
+					return false;
+
+				line_block_reader reader(block_size);
+				if (!reader.open(probe_file, has_header))
+					return false;
+				if (has_header)
 				{
-					src = replace(src, std::string(1, '\n'), newline_escape);
+					write_header(reader.get_header(), os, configure);
+					write_header(build_header, os, configure);
+					os << NEWLINE;
 				}
-				if (surround_quote_on_str || src.find(delimiter) != std::string::npos)
+
+				size_t next_block = 0;
+				size_t written = 0;
+				std::mutex mtx;
+				std::condition_variable cv;
+				std::exception_ptr error;
+				auto worker = [&]()
 				{
-					if (!quote_escape.empty())
+					try
+					{
+						istringstream is;
+						configure(is);
+						prepare(is);
+						ostringstream fmt;
+						fmt.set_format(os);
+						std::string block, key, field, out;
+						while (true)
+						{
+							size_t b = 0;
+							{
+								std::lock_guard<std::mutex> lock(mtx);
+								if (error || !reader.next(block))
+									return;
+								b = next_block++;
+							}
+							out.clear();
+							fmt.set_output_string(out);
+							fmt.set_after_newline(true);
+							is.set_new_input_buffer(block.data(), block.size());
+							while (is.read_line())
+								probe(is, key, field, fmt);
+
+							// blocks are written in the order they were read
+							std::unique_lock<std::mutex> lock(mtx);
+							cv.wait(lock, [&]() { return error || written == b; });
+							if (error)
+								return;
+							os.get_ofstream().write(out.data(), static_cast<std::streamsize>(out.size()));
+							++written;
+							cv.notify_all();
+						}
+					}
+					catch (...)
 					{
-						src = replace(src, std::string(1, surround_quote), quote_escape);
+						std::lock_guard<std::mutex> lock(mtx);
+						if (!error)
+							error = std::current_exception();
+						cv.notify_all();
 					}
-					ostm << surround_quote << src << surround_quote;
-				}
-				else
+				};
+
+				std::vector<std::thread> pool;
+				for (size_t t = 0; t < threads; ++t)
+					pool.push_back(std::thread(worker));
+				for (size_t t = 0; t < pool.size(); ++t)
+					pool[t].join();
+				if (error)
+					std::rethrow_exception(error);
+
+				os.set_after_newline(true);
+				return bool(os.get_ofstream());
+			}
+		private:
+			struct no_configure
+			{
+				void operator()(istream_base&) const {}
+			};
+			static void prepare(istream_base& is)
+			{
+				is.enable_field_offsets(true);
+				is.enable_terminate_on_blank_line(false);
+				is.enable_blank_line(false);
+			}
+			template<typename Configure>
+			bool build(const std::string& file, std::string& header, Configure& configure)
+			{
+				keys = key_interner();
+				first_row.clear();
+				last_row.clear();
+				next_row.clear();
+				row_begin.assign(1, 0);
+				field_begin.clear();
+				field_len.clear();
+				arena.clear();
+				build_width = 0;
+
+				line_block_reader reader(block_size);
+				if (!reader.open(file, has_header))
+					return false;
+				header = reader.get_header();
+
+				istringstream is;
+				configure(is);
+				prepare(is);
+				std::string block, key;
+				while (reader.next(block))
 				{
-					ostm << src;
+					is.set_new_input_buffer(block.data(), block.size());
+					while (is.read_line())
+					{
+						const size_t row = next_row.size();
+						for (size_t k = 0; k < is.field_count(); ++k)
+						{
+							const std::string& text = is.field(k);
+							field_begin.push_back(arena.size());
+							field_len.push_back(text.size());
+							arena += text;
+						}
+						row_begin.push_back(field_begin.size());
+						build_width = std::max(build_width, is.field_count());
+
+						// rows of a key are chained in file order
+						make_key(is, build_columns, key);
+						const size_t id = keys.intern(key);
+						const size_t none = key_interner::npos;
+						next_row.push_back(none);
+						if (id == first_row.size())
+						{
+							first_row.push_back(row);
+							last_row.push_back(row);
+						}
+						else
+						{
+							next_row[last_row[id]] = row;
+							last_row[id] = row;
+						}
+					}
 				}
+				return true;
 			}
-		private:
-			std::ostringstream ostm;
-		};
-
-
-	} // ns csv
-} // ns mini
-
-template<typename T>
-mini::csv::istringstream& operator >> (mini::csv::istringstream& istm, T& val)
-{
-	const std::string& str = istm.get_delimited_str();
-
-#ifdef USE_BOOST_LEXICAL_CAST
-	try
-	{
-		val = boost::lexical_cast<T>(str);
-	}
-	catch (boost::bad_lexical_cast& e)
-	{
-		throw std::runtime_error(istm.error_line(str, MY_FUNC_SIG).c_str());
-	}
-#else
-	std::istringstream is(str);
-	is >> val;
-	if (!(bool)is)
-	{
-		throw std::runtime_error(istm.error_line(str, MY_FUNC_SIG).c_str());
-	}
-#endif
-
-	return istm;
-}
-template<>
-inline mini::csv::istringstream& operator >> (mini::csv::istringstream& istm, std::string& val)
-{
-	val = istm.get_delimited_str();
-
-	return istm;
-}
-
-template<>
-inline mini::csv::istringstream& operator >> (mini::csv::istringstream& istm, mini::csv::sep& val)
-{
-	istm.set_delimiter(val.get_delimiter(), val.get_escape());
-
-	return istm;
-}
-
-inline mini::csv::istringstream& operator >> (mini::csv::istringstream& istm, mini::csv::NChar val)
-{
-	const std::string& str = istm.get_delimited_str();
-
-	int n = 0;
-#ifdef USE_BOOST_LEXICAL_CAST
-	try
-	{
-		n = boost::lexical_cast<int>(str);
-	}
-	catch (boost::bad_lexical_cast& e)
-	{
-		throw std::runtime_error(istm.error_line(str, MY_FUNC_SIG).c_str());
-	}
-#else
-	std::istringstream is(str);
-	is >> n;
-	if (!(bool)is)
-	{
-		throw std::runtime_error(istm.error_line(str, MY_FUNC_SIG).c_str());
-	}
-#endif
-
-	if (n > 127 || n < -128)
-	{
-		throw std::runtime_error(istm.error_line(str, MY_FUNC_SIG).c_str());
-	}
-
-	char temp = static_cast<char>(n);
-	val.setChar(temp);
-
-	return istm;
-}
-
-template<>
-inline mini::csv::istringstream& operator >> (mini::csv::istringstream& istm, char& val)
-{
-	const std::string& src = istm.get_delimited_str();
-
-	if (src.empty())
-	{
-		throw std::runtime_error(istm.error_line(src, MY_FUNC_SIG).c_str());
-	}
-
-	val = src[0];
-
-	return istm;
-}
-
-template<typename T>
-mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const T& val)
-{
-	if (!ostm.get_after_newline())
-		ostm.get_ostringstream() << ostm.get_delimiter();
-
-	std::ostringstream os_temp;
-
-	os_temp << val;
-
-	ostm.escape_and_output(os_temp.str());
-
-	ostm.set_after_newline(false);
-
-	return ostm;
-}
-template<typename T>
-mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const T* val)
-{
-	if (!ostm.get_after_newline())
-		ostm.get_ostringstream() << ostm.get_delimiter();
-
-	std::ostringstream os_temp;
-
-	os_temp << *val;
-
-	ostm.escape_and_output(os_temp.str());
-
-	ostm.set_after_newline(false);
-
-	return ostm;
-}
-template<>
-inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const std::string& val)
-{
-	if (!ostm.get_after_newline())
-		ostm.get_ostringstream() << ostm.get_delimiter();
-
-	std::string temp = val;
-	ostm.escape_str_and_output(temp);
-
-	ostm.set_after_newline(false);
-
-	return ostm;
-}
-template<>
-inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const mini::csv::sep& val)
-{
-	ostm.set_delimiter(val.get_delimiter(), val.get_escape());
-
-	return ostm;
-}
-
-template<>
-inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const char& val)
-{
-	if (val == NEWLINE)
-	{
-		ostm.get_ostringstream() << NEWLINE;
-
-		ostm.set_after_newline(true);
-	}
-	else
-	{
-		if (!ostm.get_after_newline())
-			ostm.get_ostringstream() << ostm.get_delimiter();
-
-		std::string temp = "";
-		temp += val;
-		ostm.escape_str_and_output(temp);
-
-		ostm.set_after_newline(false);
-	}
-
-	return ostm;
-}
-
-inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, mini::csv::NChar val)
-{
-	if (!ostm.get_after_newline())
-		ostm.get_ostringstream() << ostm.get_delimiter();
-
-	std::ostringstream os_temp;
-
-	os_temp << static_cast<int>(val.getChar());
-
-	ostm.escape_and_output(os_temp.str());
-
-	ostm.set_after_newline(false);
-
-	return ostm;
-}
-
-template<>
-inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const char* val)
-{
-	const std::string temp = val;
-
-	ostm << temp;
-
-	return ostm;
-}
-
-inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const float val)
-{
-	if (!ostm.get_after_newline())
-		ostm.get_ostringstream() << ostm.get_delimiter();
+			template<typename Configure>
+			static void write_header(const std::string& line, ofstream& os, Configure& configure)
+			{
+				istringstream is;
+				configure(is);
+				is.enable_field_offsets(true);
+				is.set_new_input_buffer(line.data(), line.size());
+				if (!is.read_line())
+					return;
+				for (size_t k = 0; k < is.field_count(); ++k)
+					os << is.field(k);
+			}
+			void probe(istream_base& is, std::string& key, std::string& field, ostringstream& fmt) const
+			{
+				const size_t none = key_interner::npos;
+				make_key(is, probe_columns, key);
+				const size_t id = keys.find(key);
+				if (id == none && type == inner)
+					return;
 
-	// Need a temporary output stream as float output may contains a comma or the delimiter
-	std::ostringstream os_temp;
+				size_t row = (id == none) ? none : first_row[id];
+				do
+				{
+					for (size_t k = 0; k < is.field_count(); ++k)
+						fmt << is.field(k);
+					const size_t width = (row == none) ? 0 : row_begin[row + 1] - row_begin[row];
+					for (size_t k = 0; k < build_width; ++k)
+					{
+						if (k < width)
+							field.assign(arena, field_begin[row_begin[row] + k], field_len[row_begin[row] + k]);
+						else
+							field.clear();
+						fmt << field;
+					}
+					fmt << NEWLINE;
+					row = (row == none) ? none : next_row[row];
+				} while (row != none);
+			}
 
-	if (ostm.get_precision() > 0)
-	{
-		os_temp << std::fixed << std::showpoint << std::setprecision(ostm.get_precision());
-	}
+			size_t threads;
+			size_t block_size;
+			bool has_header;
+			join_type type;
+			std::vector<size_t> probe_columns;
+			std::vector<size_t> build_columns;
+			// build side: rows of fields in one arena, and the rows of each key
+			key_interner keys;
+			std::vector<size_t> first_row;
+			std::vector<size_t> last_row;
+			std::vector<size_t> next_row;
+			std::vector<size_t> row_begin;
+			std::vector<size_t> field_begin;
+			std::vector<size_t> field_len;
+			std::string arena;
+			size_t build_width;
+		};
 
-	os_temp << val;
+		// Bloom filter over precomputed 64-bit hashes, probed by double hashing
+		class bloom_filter
+		{
+		public:
+			explicit bloom_filter(size_t bits = 1 << 20, size_t hashes_ = 4)
+				: hashes(hashes_ ? hashes_ : 1)
+			{
+				size_t n = 64;
+				while (n < bits)
+					n *= 2;
+				words.assign(n / 64, 0);
+				mask = n - 1;
+			}
+			void add(uint64_t hash)
+			{
+				const uint64_t step = (hash >> 33) | 1;
+				for (size_t i = 0; i < hashes; ++i, hash += step)
+				{
+					const size_t bit = static_cast<size_t>(hash) & mask;
+					words[bit / 64] |= uint64_t(1) << (bit % 64);
+				}
+			}
+			// false when the hash was certainly never added
+			bool maybe_contains(uint64_t hash) const
+			{
+				const uint64_t step = (hash >> 33) | 1;
+				for (size_t i = 0; i < hashes; ++i, hash += step)
+				{
+					const size_t bit = static_cast<size_t>(hash) & mask;
+					if ((words[bit / 64] & (uint64_t(1) << (bit % 64))) == 0)
+						return false;
+				}
+				return true;
+			}
+			size_t memory() const
+			{
+				return words.size() * sizeof(uint64_t);
+			}
+		private:
+			std::vector<uint64_t> words;
+			size_t mask;
+			size_t hashes;
+		};
 
-	ostm.escape_and_output(os_temp.str());
+		// Removes the duplicate lines of a CSV file, keeping the first occurrence. Lines are
+		// compared on their raw bytes, or on the decoded key columns when keys are added.
+		// New lines are mostly told apart by a bloom filter, without the exact lookup.
+		// Once the seen keys outgrow the memory budget, they and the rest of the file are
+		// partitioned by hash into temporary files that are deduplicated one at a time,
+		// so the survivors of the rest of the file come out grouped by partition. A
+		// partition whose keys outgrow the budget in turn is partitioned again with another
+		// hash, up to max_levels deep; past that, or for a single key, it is held whole.
+		class deduplicator
+		{
+		public:
+			explicit deduplicator(size_t memory_budget_ = 256 * 1024 * 1024)
+				: memory_budget(memory_budget_ ? memory_budget_ : 1)
+				, has_header(false)
+				, rows(0)
+				, duplicate_rows(0)
+			{
+			}
+			void add_key(size_t column)
+			{
+				key_columns.push_back(column);
+			}
+			// Copy the first line to the output
+			void set_header(bool has_header_)
+			{
+				has_header = has_header_;
+			}
+			// Directory of the temporary partition files, the output directory by default
+			void set_temp_dir(const std::string& dir)
+			{
+				temp_dir = dir;
+			}
+			bool run(const std::string& input, const std::string& output)
+			{
+				return run(input, output, no_configure());
+			}
+			// configure(csv::istream_base&) sets the delimiter, quote and escapes of the file
+			template<typename Configure>
+			bool run(const std::string& input, const std::string& output, Configure configure)
+			{
+				rows = 0;
+				duplicate_rows = 0;
+				ifstream is(input);
+				if (!is.is_open())
+					return false;
+				configure(is);
+				is.enable_field_offsets(!key_columns.empty());
+
+				std::ofstream os(output.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+				if (!os.is_open())
+					return false;
+				if (has_header && is.read_line())
+					os << is.get_line() << NEWLINE;
+
+				key_interner seen;
+				bloom_filter bloom(memory_budget);
+				std::vector<std::string> part_files;
+				std::vector<std::ofstream*> parts;
+				std::string key;
+				bool ok = true;
+				while (ok && is.read_line())
+				{
+					++rows;
+					const std::string& line = is.get_line();
+					if (!key_columns.empty())
+						make_key(is, key_columns, key);
+					const std::string& k = key_columns.empty() ? line : key;
+					const uint64_t hash = fnv1a(k.data(), k.size());
+
+					if (!parts.empty())
+					{
+						write_record(*parts[partition(hash, 0, parts.size())], 1, k, line);
+						continue;
+					}
+					if (bloom.maybe_contains(hash) && seen.find(k.data(), k.size(), hash) != key_interner::npos)
+					{
+						++duplicate_rows;
+						continue;
+					}
+					bloom.add(hash);
+					seen.add(k.data(), k.size(), hash);
+					os << line << NEWLINE;
 
-	ostm.set_after_newline(false);
+					if (seen.memory() + bloom.memory() > memory_budget)
+					{
+						ok = spill(input, temp_file_prefix(output, temp_dir) + ".part", seen, 0, part_files, parts);
+						seen = key_interner();
+					}
+				}
 
-	return ostm;
-}
+				ok = dedup_partitions(part_files, parts, os, 1) && ok;
+				return ok && bool(os);
+			}
+			// Data lines read by the last run, header excluded
+			size_t row_count() const
+			{
+				return rows;
+			}
+			size_t duplicates() const
+			{
+				return duplicate_rows;
+			}
+		private:
+			struct no_configure
+			{
+				void operator()(istream_base&) const {}
+			};
+			// partition records: a kind byte (0 for a seen key, 1 for a pending line), the
+			// length-prefixed key and, for a pending line, the length-prefixed line
+			static void write_record(std::ostream& out, char kind, const std::string& key, const std::string& line)
+			{
+				const uint32_t key_len = static_cast<uint32_t>(key.size());
+				out.put(kind);
+				out.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
+				out.write(key.data(), key_len);
+				if (kind == 1)
+				{
+					const uint32_t line_len = static_cast<uint32_t>(line.size());
+					out.write(reinterpret_cast<const char*>(&line_len), sizeof(line_len));
+					out.write(line.data(), line_len);
+				}
+			}
+			static bool read_field(std::istream& in, std::string& field)
+			{
+				uint32_t len = 0;
+				if (!in.read(reinterpret_cast<char*>(&len), sizeof(len)))
+					return false;
+				field.resize(len);
+				return len == 0 || bool(in.read(&field[0], len));
+			}
+			// the interner slots use the low bits of the hash, partitions the high ones. Each
+			// level mixes the hash with its own seed, so that the keys of one partition
+			// spread over the partitions of the next level.
+			static size_t partition(uint64_t hash, size_t level, size_t count)
+			{
+				if (level > 0)
+				{
+					hash ^= level * 0x9E3779B97F4A7C15ULL;
+					hash ^= hash >> 33;
+					hash *= 0xFF51AFD7ED558CCDULL;
+					hash ^= hash >> 33;
+				}
+				return static_cast<size_t>(hash >> 40) % count;
+			}
+			static const size_t max_levels = 8;
+			// Opens the partitions of the records still to come from source, and writes the
+			// seen keys to them
+			bool spill(const std::string& source, const std::string& prefix, const key_interner& seen, size_t level,
+				std::vector<std::string>& part_files, std::vector<std::ofstream*>& parts)
+			{
+				uint64_t size = 0;
+				int64_t mtime = 0;
+				file_stat(source, size, mtime);
+				const size_t count = static_cast<size_t>(std::min<uint64_t>(256, std::max<uint64_t>(2, 2 * size / memory_budget + 1)));
+				for (size_t p = 0; p < count; ++p)
+				{
+					std::ostringstream name;
+					name << prefix << p;
+					part_files.push_back(name.str());
+					parts.push_back(new std::ofstream(name.str().c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc));
+					if (!parts.back()->is_open())
+						return false;
+				}
+				std::string key;
+				for (size_t id = 0; id < seen.size(); ++id)
+				{
+					key = seen.key(id).to_string();
+					write_record(*parts[partition(fnv1a(key.data(), key.size()), level, count)], 0, key, key);
+				}
+				return true;
+			}
+			// Closes the partitions, deduplicates them one at a time and removes their files
+			bool dedup_partitions(const std::vector<std::string>& part_files, std::vector<std::ofstream*>& parts, std::ostream& os, size_t level)
+			{
+				bool ok = true;
+				for (size_t p = 0; p < parts.size(); ++p)
+				{
+					ok = ok && bool(*parts[p]);
+					delete parts[p];
+				}
+				parts.clear();
+				for (size_t p = 0; ok && p < part_files.size(); ++p)
+					ok = dedup_partition(part_files[p], os, level);
+				for (size_t p = 0; p < part_files.size(); ++p)
+					std::remove(part_files[p].c_str());
+				return ok;
+			}
+			// Like run, on the records of a partition: its seen keys come first, then its
+			// pending lines in file order
+			bool dedup_partition(const std::string& file, std::ostream& os, size_t level)
+			{
+				std::ifstream in(file.c_str(), std::ios_base::in | std::ios_base::binary);
+				if (!in.is_open())
+					return false;
+				key_interner seen;
+				std::vector<std::string> part_files;
+				std::vector<std::ofstream*> parts;
+				std::string key, line;
+				char kind = 0;
+				bool ok = true;
+				while (ok && in.get(kind))
+				{
+					if (!read_field(in, key) || (kind == 1 && !read_field(in, line)))
+					{
+						ok = false;
+						break;
+					}
+					const uint64_t hash = fnv1a(key.data(), key.size());
+					if (!parts.empty())
+					{
+						write_record(*parts[partition(hash, level, parts.size())], kind, key, line);
+						continue;
+					}
+					if (kind == 1)
+					{
+						if (seen.find(key.data(), key.size(), hash) != key_interner::npos)
+						{
+							++duplicate_rows;
+							continue;
+						}
+						os << line << NEWLINE;
+					}
+					seen.add(key.data(), key.size(), hash);
 
-inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const double val)
-{
-	if (!ostm.get_after_newline())
-		ostm.get_ostringstream() << ostm.get_delimiter();
+					if (seen.memory() > memory_budget && seen.size() > 1 && level < max_levels)
+					{
+						ok = spill(file, file + ".", seen, level, part_files, parts);
+						seen = key_interner();
+					}
+				}
+				return dedup_partitions(part_files, parts, os, level + 1) && ok;
+			}
 
-	// Need a temporary output stream as float output may contains a comma or the delimiter
-	std::ostringstream os_temp;
+			size_t memory_budget;
+			bool has_header;
+			std::string temp_dir;
+			std::vector<size_t> key_columns;
+			size_t rows;
+			size_t duplicate_rows;
+		};
 
-	if (ostm.get_precision() > 0)
-	{
-		os_temp << std::fixed << std::showpoint << std::setprecision(ostm.get_precision());
-	}
+		// Bounded lock-free queue for many producers and many consumers. Each cell carries a
+		// sequence number which tells whether it is free for the next push or ready for the
+		// next pop, so a push or pop is a single compare and swap on the position.
+		template<typename T>
+		class mpmc_queue
+		{
+		public:
+			// The capacity is rounded up to a power of 2
+			explicit mpmc_queue(size_t capacity)
+				: cells(round_up(capacity))
+				, mask(cells.size() - 1)
+				, push_pos(0)
+				, pop_pos(0)
+			{
+				for (size_t i = 0; i < cells.size(); ++i)
+					cells[i].seq.store(i, std::memory_order_relaxed);
+			}
+			// False when the queue is full
+			bool try_push(const T& val)
+			{
+				size_t pos = push_pos.load(std::memory_order_relaxed);
+				cell* c;
+				for (;;)
+				{
+					c = &cells[pos & mask];
+					const size_t seq = c->seq.load(std::memory_order_acquire);
+					const std::ptrdiff_t dif = static_cast<std::ptrdiff_t>(seq - pos);
+					if (dif == 0)
+					{
+						if (push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+							break;
+					}
+					else if (dif < 0)
+						return false;
+					else
+						pos = push_pos.load(std::memory_order_relaxed);
+				}
+				c->val = val;
+				c->seq.store(pos + 1, std::memory_order_release);
+				return true;
+			}
+			// False when the queue is empty
+			bool try_pop(T& val)
+			{
+				size_t pos = pop_pos.load(std::memory_order_relaxed);
+				cell* c;
+				for (;;)
+				{
+					c = &cells[pos & mask];
+					const size_t seq = c->seq.load(std::memory_order_acquire);
+					const std::ptrdiff_t dif = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+					if (dif == 0)
+					{
+						if (pop_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+							break;
+					}
+					else if (dif < 0)
+						return false;
+					else
+						pos = pop_pos.load(std::memory_order_relaxed);
+				}
+				val = c->val;
+				c->seq.store(pos + mask + 1, std::memory_order_release);
+				return true;
+			}
+			size_t capacity() const
+			{
+				return cells.size();
+			}
+		private:
+			mpmc_queue(const mpmc_queue&);
+			mpmc_queue& operator=(const mpmc_queue&);
 
-	os_temp << val;
+			struct cell
+			{
+				std::atomic<size_t> seq;
+				T val;
+			};
+			static size_t round_up(size_t n)
+			{
+				size_t cap = 2;
+				while (cap < n)
+					cap <<= 1;
+				return cap;
+			}
 
-	ostm.escape_and_output(os_temp.str());
+			std::vector<cell> cells;
+			const size_t mask;
+			char pad0[64];	// keeps the producer and consumer positions on separate cache lines
+			std::atomic<size_t> push_pos;
+			char pad1[64];
+			std::atomic<size_t> pop_pos;
+			char pad2[64];
+		};
 
-	ostm.set_after_newline(false);
+		// Reads a file on the calling thread and hands batches of whole lines to consumer
+		// threads through a lock-free queue. Each consumer parses its batches with its own
+		// istringstream, so parsing scales with the number of consumers instead of being
+		// serialized behind a shared reader.
+		class row_dispatcher
+		{
+		public:
+			explicit row_dispatcher(size_t consumers_ = 0, size_t batch_size_ = 256 * 1024, size_t batches_in_flight_ = 0)
+				: consumers(consumers_ ? consumers_ : std::max<size_t>(1, std::thread::hardware_concurrency()))
+				, batch_size(batch_size_)
+				, batches_in_flight(batches_in_flight_ ? batches_in_flight_ : 4 * consumers)
+				, has_header(false)
+				, batches(0)
+			{
+			}
+			// The header line is not dispatched, it is available from get_header()
+			void set_header(bool has_header_)
+			{
+				has_header = has_header_;
+			}
+			const std::string& get_header() const
+			{
+				return header;
+			}
+			// Number of batches the last run dispatched
+			size_t batch_count() const
+			{
+				return batches;
+			}
+			template<typename Handler>
+			bool run(const std::string& file, Handler handler)
+			{
+				return run(file, handler, no_configure());
+			}
+			// handler(csv::istringstream& is, size_t consumer) is called on a consumer thread
+			// for every row, after read_line, and may read the row with operator>>. Rows of a
+			// batch are handled in order on one consumer, batches run concurrently.
+			// configure(csv::istream_base&) sets the delimiter, quote and escapes. get_line_num()
+			// gives the line number in the file. Blank lines are skipped. An exception thrown by
+			// the handler stops the run and is rethrown.
+			template<typename Handler, typename Configure>
+			bool run(const std::string& file, Handler handler, Configure configure)
+			{
+				batches = 0;
+				line_block_reader reader(batch_size);
+				if (!reader.open(file, has_header))
+					return false;
+				header = reader.get_header();
+
+				// batches cycle between the free queue and the ready queue, NULL ends a consumer
+				std::vector<batch> pool(batches_in_flight);
+				mpmc_queue<batch*> free_batches(pool.size());
+				mpmc_queue<batch*> ready(pool.size() + consumers);
+				for (size_t i = 0; i < pool.size(); ++i)
+					free_batches.try_push(&pool[i]);
+
+				std::atomic<bool> failed(false);
+				std::mutex error_mtx;
+				std::exception_ptr error;
+				auto consumer = [&](size_t index)
+				{
+					istringstream is;
+					configure(is);
+					is.enable_terminate_on_blank_line(false);
+					is.enable_blank_line(false);
+					batch* b = NULL;
+					while (true)
+					{
+						backoff wait;
+						while (!ready.try_pop(b))
+							wait.pause();
+						if (b == NULL)
+							return;
+						if (!failed.load(std::memory_order_relaxed))
+						{
+							try
+							{
+								is.set_new_input_buffer(b->text.data(), b->text.size());
+								is.set_line_num(b->first_line);
+								while (is.read_line())
+									handler(is, index);
+							}
+							catch (...)
+							{
+								std::lock_guard<std::mutex> lock(error_mtx);
+								if (!error)
+									error = std::current_exception();
+								failed.store(true);
+							}
+						}
+						free_batches.try_push(b);
+					}
+				};
 
-	return ostm;
-}
+				std::vector<std::thread> threads;
+				for (size_t t = 0; t < consumers; ++t)
+					threads.push_back(std::thread(consumer, t));
 
-inline mini::csv::ostringstream& operator << (mini::csv::ostringstream& ostm, const long double val)
-{
-	if (!ostm.get_after_newline())
-		ostm.get_ostringstream() << ostm.get_delimiter();
+				size_t line = has_header ? 1 : 0;
+				while (!failed.load(std::memory_order_relaxed))
+				{
+					batch* b = NULL;
+					backoff wait;
+					while (!free_batches.try_pop(b) && !failed.load(std::memory_order_relaxed))
+						wait.pause();
+					if (b == NULL || !reader.next(b->text))
+						break;
+					b->first_line = line;
+					line += line_block_reader::count_lines(b->text);
+					ready.try_push(b);
+					++batches;
+				}
+				for (size_t t = 0; t < consumers; ++t)
+				{
+					backoff wait;
+					while (!ready.try_push(NULL))
+						wait.pause();
+				}
+				for (size_t t = 0; t < threads.size(); ++t)
+					threads[t].join();
+				if (error)
+					std::rethrow_exception(error);
+				return true;
+			}
+		private:
+			struct batch
+			{
+				batch() : first_line(0) {}
+				std::string text;
+				size_t first_line; // line number before the first line of the batch
+			};
+			struct no_configure
+			{
+				void operator()(istream_base&) const {}
+			};
+			// Yields while a wait is short, then sleeps so that idle threads do not spin
+			struct backoff
+			{
+				backoff() : spins(0) {}
+				void pause()
+				{
+					if (++spins < 64)
+						std::this_thread::yield();
+					else
+						std::this_thread::sleep_for(std::chrono::microseconds(50));
+				}
+				unsigned spins;
+			};
+
+			size_t consumers;
+			size_t batch_size;
+			size_t batches_in_flight;
+			bool has_header;
+			std::string header;
+			size_t batches;
+		};
 
-	// Need a temporary output stream as float output may contains a comma or the delimiter
-	std::ostringstream os_temp;
+		// Thread pool in which every worker has its own deque of tasks. A worker runs the
+		// newest task of its own deque, and when that is empty steals the oldest task of
+		// another worker. Each deque has its own lock, and the count of queued tasks is
+		// atomic, so the shared lock and condition variable are only used by workers going
+		// idle and by submits which wake them. Tasks must not throw. The destructor runs
+		// the queued tasks first.
+		class work_stealing_pool
+		{
+		public:
+			explicit work_stealing_pool(size_t threads = 0)
+				: queues(threads ? threads : std::max<size_t>(1, std::thread::hardware_concurrency()))
+				, stopping(false)
+				, queued(0)
+				, sleepers(0)
+				, next_queue(0)
+			{
+				for (size_t i = 0; i < queues.size(); ++i)
+					workers.push_back(std::thread(&work_stealing_pool::work, this, i));
+			}
+			~work_stealing_pool()
+			{
+				{
+					std::lock_guard<std::mutex> lock(idle_mtx);
+					stopping = true;
+				}
+				idle_cv.notify_all();
+				for (size_t i = 0; i < workers.size(); ++i)
+					workers[i].join();
+			}
+			size_t size() const
+			{
+				return queues.size();
+			}
+			// A task submitted by a worker goes to its own deque, others are spread round robin
+			void submit(const std::function<void()>& task)
+			{
+				const worker_id& self = current();
+				const size_t q = (self.first == this) ? self.second : next_queue.fetch_add(1) % queues.size();
+				{
+					std::lock_guard<std::mutex> lock(queues[q].mtx);
+					queues[q].tasks.push_back(task);
+					queued.fetch_add(1);
+				}
+				// pairs with the sleepers increment and queued check of an idle worker, so
+				// that either the worker sees the task or this sees the worker
+				if (sleepers.load() > 0)
+				{
+					std::lock_guard<std::mutex> lock(idle_mtx);
+					idle_cv.notify_one();
+				}
+			}
+		private:
+			work_stealing_pool(const work_stealing_pool&);
+			work_stealing_pool& operator=(const work_stealing_pool&);
 
-	if (ostm.get_precision() > 0)
-	{
-		os_temp << std::fixed << std::showpoint << std::setprecision(ostm.get_precision());
-	}
+			typedef std::pair<const work_stealing_pool*, size_t> worker_id;
+			struct task_queue
+			{
+				std::mutex mtx;
+				std::deque<std::function<void()> > tasks;
+			};
+			static worker_id& current()
+			{
+				static thread_local worker_id id(NULL, 0);
+				return id;
+			}
+			bool pop(size_t self, std::function<void()>& task)
+			{
+				{
+					std::lock_guard<std::mutex> lock(queues[self].mtx);
+					if (!queues[self].tasks.empty())
+					{
+						task.swap(queues[self].tasks.back());
+						queues[self].tasks.pop_back();
+						queued.fetch_sub(1);
+						return true;
+					}
+				}
+				for (size_t k = 1; k < queues.size(); ++k)
+				{
+					task_queue& victim = queues[(self + k) % queues.size()];
+					std::lock_guard<std::mutex> lock(victim.mtx);
+					if (!victim.tasks.empty())
+					{
+						task.swap(victim.tasks.front());
+						victim.tasks.pop_front();
+						queued.fetch_sub(1);
+						return true;
+					}
+				}
+				return false;
+			}
+			void work(size_t self)
+			{
+				current() = worker_id(this, self);
+				std::function<void()> task;
+				while (true)
+				{
+					if (pop(self, task))
+					{
+						task();
+						task = std::function<void()>();
+						continue;
+					}
+					std::unique_lock<std::mutex> lock(idle_mtx);
+					sleepers.fetch_add(1);
+					while (queued.load() == 0 && !stopping)
+						idle_cv.wait(lock);
+					sleepers.fetch_sub(1);
+					if (queued.load() == 0 && stopping)
+						return;
+				}
+			}
 
-	os_temp << val;
+			std::vector<task_queue> queues;
+			std::vector<std::thread> workers;
+			std::mutex idle_mtx;
+			std::condition_variable idle_cv;
+			bool stopping;
+			std::atomic<size_t> queued; // tasks in the deques
+			std::atomic<size_t> sleepers; // workers waiting on idle_cv
+			std::atomic<size_t> next_queue;
+		};
 
-	ostm.escape_and_output(os_temp.str());
+		// Read, parse and transform, and write stages of a CSV to CSV job, run as batched
+		// tasks on a work_stealing_pool. A read task reads batches of whole lines while fewer
+		// than max_batches are in flight. Each batch is parsed and transformed by a task of
+		// its own, and written in input order, or as soon as it is done when order does not
+		// matter. Writing a batch lets the read task resume.
+		class pipeline
+		{
+		public:
+			explicit pipeline(size_t threads_ = 0, size_t batch_size_ = 1024 * 1024, size_t max_batches_ = 0)
+				: threads(threads_ ? threads_ : std::max<size_t>(1, std::thread::hardware_concurrency()))
+				, batch_size(batch_size_)
+				, max_batches(max_batches_ ? max_batches_ : 4 * threads)
+				, has_header(false)
+				, ordered(true)
+				, batches(0)
+			{
+			}
+			// The header line of the input is not transformed
+			void set_header(bool has_header_)
+			{
+				has_header = has_header_;
+			}
+			// Written as the first line of the output when not empty
+			void set_output_header(const std::string& line)
+			{
+				output_header = line;
+			}
+			// Output batches in input order, true by default
+			void set_ordered(bool ordered_)
+			{
+				ordered = ordered_;
+			}
+			// Number of batches the last run read
+			size_t batch_count() const
+			{
+				return batches;
+			}
+			template<typename Transform>
+			bool run(const std::string& file, ofstream& os, Transform transform)
+			{
+				return run(file, os, transform, no_configure());
+			}
+			// transform(csv::istringstream& in, csv::ostringstream& out) is called for every
+			// row, after read_line, and writes any number of rows to out. out has the format of
+			// os. configure(csv::istream_base&) sets the delimiter, quote and escapes of the
+			// input. Blank lines are skipped. An exception thrown by transform stops the run
+			// and is rethrown.
+			template<typename Transform, typename Configure>
+			bool run(const std::string& file, ofstream& os, Transform transform, Configure configure)
+			{
+				batches = 0;
+				line_block_reader reader(batch_size);
+				if (!reader.open(file, has_header))
+					return false;
+				if (!output_header.empty())
+				{
+					os.get_ofstream() << output_header << NEWLINE;
+					os.set_after_newline(true);
+				}
 
-	ostm.set_after_newline(false);
+				std::mutex mtx;
+				std::condition_variable cv;
+				std::exception_ptr error;
+				std::map<size_t, std::string> finished;	// transformed batches waiting for their turn
+				size_t next_read = 0;
+				size_t next_write = 0;
+				size_t in_flight = 0;
+				size_t line = has_header ? 1 : 0;
+				bool reading = true;	// a read task is queued or running
+				bool read_done = false;
+
+				// the pool is destroyed first, so no task outlives the state above
+				std::function<void()> read_task;
+				work_stealing_pool pool(threads);
+
+				auto write_batch = [&](size_t seq, std::string& out)
+				{
+					std::lock_guard<std::mutex> lock(mtx);
+					if (ordered)
+					{
+						finished[seq].swap(out);
+						std::map<size_t, std::string>::iterator it;
+						while ((it = finished.begin()) != finished.end() && it->first == next_write)
+						{
+							if (!error)
+								os.get_ofstream().write(it->second.data(), static_cast<std::streamsize>(it->second.size()));
+							finished.erase(it);
+							++next_write;
+							--in_flight;
+						}
+					}
+					else
+					{
+						if (!error)
+							os.get_ofstream().write(out.data(), static_cast<std::streamsize>(out.size()));
+						--in_flight;
+					}
+					if (!reading && !read_done && !error && in_flight < max_batches)
+					{
+						reading = true;
+						pool.submit(read_task);
+					}
+					cv.notify_all();
+				};
+				auto process = [&, write_batch](const std::shared_ptr<std::string>& block, size_t seq, size_t first_line)
+				{
+					std::string out;
+					try
+					{
+						istringstream is;
+						configure(is);
+						is.enable_terminate_on_blank_line(false);
+						is.enable_blank_line(false);
+						is.set_new_input_buffer(block->data(), block->size());
+						is.set_line_num(first_line);
+						ostringstream fmt;
+						fmt.set_format(os);
+						fmt.set_output_string(out);
+						fmt.set_after_newline(true);
+						while (is.read_line())
+							transform(is, fmt);
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(mtx);
+						if (!error)
+							error = std::current_exception();
+					}
+					write_batch(seq, out);
+				};
+				read_task = [&, process]()
+				{
+					try
+					{
+						while (true)
+						{
+							{
+								std::lock_guard<std::mutex> lock(mtx);
+								if (error || in_flight >= max_batches)
+								{
+									reading = false;
+									cv.notify_all();
+									return;
+								}
+							}
+							std::shared_ptr<std::string> block = std::make_shared<std::string>();
+							if (!reader.next(*block))
+							{
+								std::lock_guard<std::mutex> lock(mtx);
+								reading = false;
+								read_done = true;
+								cv.notify_all();
+								return;
+							}
+							const size_t first_line = line;
+							line += line_block_reader::count_lines(*block);
+
+							size_t seq = 0;
+							{
+								std::lock_guard<std::mutex> lock(mtx);
+								seq = next_read++;
+								++in_flight;
+								++batches;
+							}
+							pool.submit([process, block, seq, first_line]() { process(block, seq, first_line); });
+						}
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(mtx);
+						if (!error)
+							error = std::current_exception();
+						reading = false;
+						cv.notify_all();
+					}
+				};
+				pool.submit(read_task);
+				{
+					std::unique_lock<std::mutex> lock(mtx);
+					cv.wait(lock, [&]() { return !reading && in_flight == 0; });
+				}
+				if (error)
+					std::rethrow_exception(error);
 
-	return ostm;
-}
+				os.set_after_newline(true);
+				return bool(os.get_ofstream());
+			}
+		private:
+			struct no_configure
+			{
+				void operator()(istream_base&) const {}
+			};
+
+			size_t threads;
+			size_t batch_size;
+			size_t max_batches;
+			bool has_header;
+			bool ordered;
+			std::string output_header;
+			size_t batches;
+		};
+	} // ns csv
+} // ns mini
 
 #endif // MiniCSV_H
\ No newline at end of file